@@ -0,0 +1,311 @@
+#include "bdd.h"
+#include <algorithm>
+#include <climits>
+
+using namespace std;
+
+static inline size_t hashTriple(uint32_t a, uint32_t b, uint32_t c)
+{
+	uint64_t h = ((uint64_t) a << 32 | b) * 0x9e3779b97f4a7c15ULL;
+
+	return (size_t) (h >> 29) ^ ((size_t) c * 0x85ebca6bU);
+}
+
+//-----------------------------------------------------------------------------
+// Construction
+//-----------------------------------------------------------------------------
+const Bdd::Ref Bdd::ONE;
+const Bdd::Ref Bdd::ZERO;
+const Bdd::Ref Bdd::NONE;
+const size_t Bdd::MAX_NODES;
+const uint32_t Bdd::EMPTY;
+
+// The atoms of the pool get their levels here, so the pool must not get new
+// atoms while the Bdd is used.
+Bdd::Bdd(const FormulaPool &pool, BddOrder order, size_t maxNodes)
+	: _pool(pool), _table(1024, EMPTY), _cache(1 << 12, CacheEntry{NONE, NONE, NONE, NONE}),
+	  _refs(pool.size(), NONE), _numVariables(0), _maxNodes(maxNodes)
+{
+	_nodes.push_back(Node{UINT_MAX, ONE, ONE});
+	this->order(order);
+}
+
+void Bdd::order(BddOrder order)
+{
+	NodeList atoms;
+	vector<unsigned> uses(_pool.size(), 0);
+
+	for(NodeId n = 0; n < _pool.size(); n++)
+	{
+		switch(_pool.getType(n))
+		{
+			case T_ATOM:
+				atoms.push_back(n);
+				break;
+			case T_TRUE:
+			case T_FALSE:
+				break;
+			case T_NOT:
+				uses[_pool.getOp(n)]++;
+				break;
+			default:
+				uses[_pool.getOp1(n)]++;
+				uses[_pool.getOp2(n)]++;
+				break;
+		}
+	}
+
+	// atoms are imported in order of first appearance, which is BO_INPUT
+	if(order == BO_NAME)
+		sort(atoms.begin(), atoms.end(), [this](NodeId a, NodeId b)
+		{
+			return _pool.getId(a) < _pool.getId(b);
+		});
+	else if(order == BO_FANOUT)
+		stable_sort(atoms.begin(), atoms.end(), [&uses](NodeId a, NodeId b)
+		{
+			return uses[a] > uses[b];
+		});
+
+	_levels.assign(_pool.size(), 0);
+	for(NodeId a : atoms)
+		_levels[a] = _numVariables++;
+}
+
+// Builds the BDD of every node of the pool up to root that has none yet, so
+// the formulas of one pool share their nodes. Returns NONE if there are too
+// many nodes.
+Bdd::Ref Bdd::build(NodeId root)
+{
+	assert(root < _refs.size() && "node was added to the pool after the Bdd");
+
+	for(NodeId n = 0; n <= root; n++)
+	{
+		if(_refs[n] != NONE)
+			continue;
+
+		Ref a = NONE, b = NONE;
+		Type t = _pool.getType(n);
+		if(t == T_NOT)
+			a = _refs[_pool.getOp(n)];
+		else if(t != T_ATOM && t != T_TRUE && t != T_FALSE)
+		{
+			a = _refs[_pool.getOp1(n)];
+			b = _refs[_pool.getOp2(n)];
+		}
+
+		switch(t)
+		{
+			case T_TRUE:
+				_refs[n] = ONE;
+				break;
+			case T_FALSE:
+				_refs[n] = ZERO;
+				break;
+			case T_ATOM:
+				_refs[n] = makeVariable(_levels[n]);
+				break;
+			case T_NOT:
+				_refs[n] = a ^ 1;
+				break;
+			case T_AND:
+				_refs[n] = ite(a, b, ZERO);
+				break;
+			case T_OR:
+				_refs[n] = ite(a, ONE, b);
+				break;
+			case T_IMP:
+				_refs[n] = ite(a, b, ONE);
+				break;
+			case T_IFF:
+				_refs[n] = ite(a, b, b ^ 1);
+				break;
+		}
+
+		if(_refs[n] == NONE)
+			return NONE;
+	}
+
+	return _refs[root];
+}
+
+Bdd::Ref Bdd::makeVariable(unsigned level)
+{
+	return makeNode(level, ONE, ZERO);
+}
+
+// returns the unique node with the given level and cofactors, or NONE if it
+// is new and there are already _maxNodes nodes
+Bdd::Ref Bdd::makeNode(unsigned level, Ref high, Ref low)
+{
+	if(high == low)
+		return high;
+
+	// the complement goes from the high edge to the edge to the node
+	Ref neg = high & 1;
+	high ^= neg;
+	low ^= neg;
+
+	size_t mask = _table.size() - 1;
+	size_t i = hashTriple(high, low, level) & mask;
+
+	for(; _table[i] != EMPTY; i = (i + 1) & mask)
+	{
+		const Node &n = _nodes[_table[i]];
+		if(n.level == level && n.high == high && n.low == low)
+			return (_table[i] << 1) | neg;
+	}
+
+	if(_nodes.size() >= _maxNodes)
+		return NONE;
+
+	uint32_t id = _nodes.size();
+	_nodes.push_back(Node{level, high, low});
+	_table[i] = id;
+
+	if(2 * _nodes.size() > _table.size())
+		rehash();
+
+	// the cache is cleared when it grows, its results are only a speedup
+	if(_nodes.size() > 2 * _cache.size())
+		_cache.assign(2 * _cache.size(), CacheEntry{NONE, NONE, NONE, NONE});
+
+	return (id << 1) | neg;
+}
+
+void Bdd::rehash()
+{
+	_table.assign(2 * _table.size(), EMPTY);
+	size_t mask = _table.size() - 1;
+
+	for(uint32_t id = 1; id < _nodes.size(); id++)
+	{
+		const Node &n = _nodes[id];
+		size_t i = hashTriple(n.high, n.low, n.level) & mask;
+
+		while(_table[i] != EMPTY)
+			i = (i + 1) & mask;
+
+		_table[i] = id;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// If-then-else
+//-----------------------------------------------------------------------------
+// Returns the result of ite(f, g, h) if it is one of the operands, or else
+// brings the call to the form cached in the computed table: f and g are not
+// complemented, and the result is to be complemented if neg is set.
+Bdd::Ref Bdd::reduce(Ref &f, Ref &g, Ref &h, Ref &neg) const
+{
+	neg = 0;
+
+	if(f == ONE)
+		return g;
+	if(f == ZERO)
+		return h;
+
+	if(g == f)
+		g = ONE;
+	else if(g == (f ^ 1))
+		g = ZERO;
+	if(h == f)
+		h = ZERO;
+	else if(h == (f ^ 1))
+		h = ONE;
+
+	if(g == h)
+		return g;
+	if(g == ONE && h == ZERO)
+		return f;
+	if(g == ZERO && h == ONE)
+		return f ^ 1;
+
+	if(f & 1)
+	{
+		f ^= 1;
+		swap(g, h);
+	}
+	if(g & 1)
+	{
+		g ^= 1;
+		h ^= 1;
+		neg = 1;
+	}
+
+	return NONE;
+}
+
+// The recursion on the cofactors is run on an explicit stack, as it is as
+// deep as the number of variables. Returns NONE if there are too many nodes.
+Bdd::Ref Bdd::ite(Ref f, Ref g, Ref h)
+{
+	Ref ret = NONE;
+
+	_stack.push_back(Frame{f, g, h, 0, 0, NONE, 0});
+
+	while(!_stack.empty())
+	{
+		Frame &top = _stack.back();
+
+		if(top.state == 0)
+		{
+			ret = reduce(top.f, top.g, top.h, top.neg);
+			if(ret != NONE)
+			{
+				_stack.pop_back();
+				continue;
+			}
+
+			const CacheEntry &e = _cache[hashTriple(top.f, top.g, top.h) & (_cache.size() - 1)];
+			if(e.f == top.f && e.g == top.g && e.h == top.h)
+			{
+				ret = e.r ^ top.neg;
+				_stack.pop_back();
+				continue;
+			}
+
+			top.level = min(level(top.f), min(level(top.g), level(top.h)));
+			top.state = 1;
+
+			Frame high{cofactor(top.f, top.level, true), cofactor(top.g, top.level, true), cofactor(top.h, top.level, true), 0, 0, NONE, 0};
+			_stack.push_back(high);
+		}
+		else if(top.state == 1)
+		{
+			top.high = ret;
+			top.state = 2;
+
+			Frame low{cofactor(top.f, top.level, false), cofactor(top.g, top.level, false), cofactor(top.h, top.level, false), 0, 0, NONE, 0};
+			_stack.push_back(low);
+		}
+		else
+		{
+			Ref r = makeNode(top.level, top.high, ret);
+			if(r == NONE)
+			{
+				_stack.clear();
+				return NONE;
+			}
+
+			_cache[hashTriple(top.f, top.g, top.h) & (_cache.size() - 1)] = CacheEntry{top.f, top.g, top.h, r};
+			ret = r ^ top.neg;
+			_stack.pop_back();
+		}
+	}
+
+	return ret;
+}
+
+//-----------------------------------------------------------------------------
+// Access
+//-----------------------------------------------------------------------------
+unsigned Bdd::numVariables() const
+{
+	return _numVariables;
+}
+
+size_t Bdd::size() const
+{
+	return _nodes.size();
+}
@@ -0,0 +1,92 @@
+#ifndef _BDD_H_
+#define _BDD_H_
+
+#include "formula_pool.h"
+
+// static variable orders: atoms in order of first appearance (left to right),
+// by name, or by the number of connectives using them, most used first
+enum BddOrder { BO_INPUT, BO_NAME, BO_FANOUT };
+
+// Reduced ordered BDDs of the formulas of a FormulaPool, with complement
+// edges. A Ref is a node index shifted left with the complement flag in
+// bit 0; the only terminal is node 0, so ONE is 0 and ZERO is 1. Nodes are
+// unique (the high edge is never complemented), so two formulas are
+// equivalent exactly when their Refs are equal. Building stops with NONE
+// once there would be more than the given number of nodes.
+class Bdd
+{
+public:
+	typedef uint32_t Ref;
+
+	static const Ref ONE = 0;
+	static const Ref ZERO = 1;
+	static const Ref NONE = UINT32_MAX;
+	static const size_t MAX_NODES = 1 << 21;
+
+	Bdd(const FormulaPool &pool, BddOrder order = BO_INPUT, size_t maxNodes = MAX_NODES);
+
+	Ref build(NodeId root);
+	Ref makeVariable(unsigned level);
+	Ref ite(Ref f, Ref g, Ref h);
+
+	unsigned numVariables() const;
+	size_t size() const;
+
+private:
+	static const uint32_t EMPTY = UINT32_MAX;
+
+	// the level of the terminal is below every variable
+	struct Node
+	{
+		unsigned level;
+		Ref high, low;
+	};
+
+	struct CacheEntry
+	{
+		Ref f, g, h, r;
+	};
+
+	// ite(f, g, h) waiting for the results of its cofactors
+	struct Frame
+	{
+		Ref f, g, h;
+		unsigned level;
+		Ref neg, high;
+		int state;
+	};
+
+	const FormulaPool &_pool;
+	std::vector<Node> _nodes;
+	// open addressing table of node indices, its size is a power of two
+	std::vector<uint32_t> _table;
+	std::vector<CacheEntry> _cache;
+	std::vector<Frame> _stack;
+	// level of each atom of the pool and the Ref of each node built so far
+	std::vector<unsigned> _levels;
+	std::vector<Ref> _refs;
+	unsigned _numVariables;
+	size_t _maxNodes;
+
+	unsigned level(Ref f) const
+	{
+		return _nodes[f >> 1].level;
+	}
+
+	Ref cofactor(Ref f, unsigned level, bool high) const
+	{
+		const Node &n = _nodes[f >> 1];
+
+		if(n.level != level)
+			return f;
+		return (high ? n.high : n.low) ^ (f & 1);
+	}
+
+	void order(BddOrder order);
+	Ref makeNode(unsigned level, Ref high, Ref low);
+	Ref reduce(Ref &f, Ref &g, Ref &h, Ref &neg) const;
+	void rehash();
+};
+
+
+#endif //_BDD_H_
@@ -0,0 +1,263 @@
+#include "prop_logic.h"
+#include "formula_pool.h"
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+using namespace std;
+
+extern int yyparse();
+extern Formula parsed_formula;
+extern void setInput(const char *begin, size_t size);
+
+// Times every stage of the transformation on formulas of scalable families.
+// Each family is written in the input syntax and parsed, so the parser is
+// measured as well. Speeds are given in nodes of the parsed formula per
+// second, peak memory as the resident set size of the process. The numbers
+// only mean something for an optimized build, as make builds by default.
+
+//-----------------------------------------------------------------------------
+// Generators
+//-----------------------------------------------------------------------------
+// n + 1 pigeons in n holes, unsatisfiable
+static void pigeonhole(ostream &out, unsigned n)
+{
+	for(unsigned i = 0; i <= n; i++)
+	{
+		out << (i > 0 ? " /\\ (" : "(");
+		for(unsigned k = 0; k < n; k++)
+			out << (k > 0 ? " \\/ " : "") << "p" << i << "_" << k;
+		out << ")";
+	}
+
+	for(unsigned k = 0; k < n; k++)
+		for(unsigned i = 0; i <= n; i++)
+			for(unsigned j = i + 1; j <= n; j++)
+				out << " /\\ (~p" << i << "_" << k << " \\/ ~p" << j << "_" << k << ")";
+	out << ";";
+}
+
+// xor of x0, ..., xn-1 as a chain a <=> ~b, once in each order, so the
+// equivalence of the two chains is a tautology
+static void parity(ostream &out, unsigned n)
+{
+	out << "(x0";
+	for(unsigned i = 1; i < n; i++)
+		out << " <=> ~x" << i;
+	out << ") <=> (x" << n - 1;
+	for(unsigned i = n - 1; i-- > 0; )
+		out << " <=> ~x" << i;
+	out << ");";
+}
+
+// Two ripple-carry adders of n bits with their carries c and d defined in
+// different ways: the definitions imply that the sums agree, a tautology.
+static void adder(ostream &out, unsigned n)
+{
+	auto carry = [](const char *name, unsigned i)
+	{
+		return i == 0 ? string("cin") : name + to_string(i);
+	};
+
+	out << "(";
+	for(unsigned i = 0; i < n; i++)
+	{
+		string a = "a" + to_string(i), b = "b" + to_string(i);
+		string c = carry("c", i), d = carry("d", i);
+
+		out << (i > 0 ? " /\\ " : "")
+			<< "(" << carry("c", i + 1) << " <=> (" << a << " /\\ " << b << ") \\/ (" << c << " /\\ (" << a << " <=> ~" << b << ")))"
+			<< " /\\ (" << carry("d", i + 1) << " <=> (" << a << " /\\ " << b << ") \\/ (" << a << " /\\ " << d << ") \\/ (" << b << " /\\ " << d << "))";
+	}
+	out << ") => (";
+	for(unsigned i = 0; i < n; i++)
+		out << (i > 0 ? " /\\ " : "")
+			<< "((a" << i << " <=> ~b" << i << " <=> ~" << carry("c", i) << ") <=> (a" << i << " <=> ~b" << i << " <=> ~" << carry("d", i) << "))";
+	out << ");";
+}
+
+// random 3-CNF over n atoms at the ratio where it is hardest, 4.26 clauses per atom
+static void random3CNF(ostream &out, unsigned n)
+{
+	mt19937 rng(n);
+	unsigned m = (unsigned) (4.26 * n);
+
+	for(unsigned i = 0; i < m; i++)
+	{
+		out << (i > 0 ? " /\\ (" : "(");
+		for(unsigned k = 0; k < 3; k++)
+			out << (k > 0 ? " \\/ " : "") << (rng() % 2 ? "~" : "") << "v" << rng() % n;
+		out << ")";
+	}
+	out << ";";
+}
+
+// balanced tree of equivalences of depth n over 2n + 1 atoms chosen at random
+static void iffTree(ostream &out, unsigned depth, mt19937 &rng, unsigned atoms)
+{
+	if(depth == 0)
+	{
+		out << "y" << rng() % atoms;
+		return;
+	}
+
+	out << "(";
+	iffTree(out, depth - 1, rng, atoms);
+	out << " <=> ";
+	iffTree(out, depth - 1, rng, atoms);
+	out << ")";
+}
+
+static void iffTree(ostream &out, unsigned n)
+{
+	mt19937 rng(n);
+
+	iffTree(out, n, rng, 2 * n + 1);
+	out << ";";
+}
+
+// conjunction of n implications between neighbours on a cycle
+static void wide(ostream &out, unsigned n)
+{
+	for(unsigned i = 0; i < n; i++)
+		out << (i > 0 ? " /\\ " : "") << "(w" << i << " \\/ ~w" << (i + 1) % n << ")";
+	out << ";";
+}
+
+struct Family
+{
+	const char *name;
+	void (*generate)(ostream&, unsigned);
+	// the size used when all families are run
+	unsigned size;
+};
+
+static const Family families[] =
+{
+	{"pigeonhole", pigeonhole, 30},
+	{"parity", parity, 50000},
+	{"adder", adder, 10000},
+	{"random3cnf", random3CNF, 20000},
+	{"iff", iffTree, 16},
+	{"wide", wide, 200000}
+};
+
+//-----------------------------------------------------------------------------
+// Measurement
+//-----------------------------------------------------------------------------
+template<typename F>
+static double timed(F stage)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	stage();
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char *stage, double seconds, size_t nodes)
+{
+	cout << "  " << left << setw(24) << stage << right << fixed
+		<< setw(12) << setprecision(2) << seconds * 1000 << " ms"
+		<< setw(16) << setprecision(0) << (seconds > 0 ? nodes / seconds : 0) << " nodes/s" << endl;
+}
+
+static void run(const Family &family, unsigned size)
+{
+	ostringstream out;
+	family.generate(out, size);
+	string text = out.str();
+
+	setInput(text.data(), text.size());
+	double parseTime = timed([]() { yyparse(); });
+
+	Formula f = parsed_formula;
+	parsed_formula = nullptr;
+	if(f.get() == nullptr)
+	{
+		cerr << family.name << ": the generated formula was not parsed" << endl;
+		exit(1);
+	}
+
+	size_t nodes;
+	{
+		FormulaPool pool;
+		pool.import(f);
+		nodes = pool.size();
+	}
+
+	cout << family.name << " " << size << ": " << text.size() << " bytes, " << nodes << " nodes" << endl;
+	report("parse", parseTime, nodes);
+
+	Formula s, p, t, n;
+	Cnf cnf;
+
+	report("simplify", timed([&]() { s = f->simplify(); }), nodes);
+	report("pushNegation", timed([&]() { p = s->pushNegation(); }), nodes);
+	report("tseitinTransformation", timed([&]() { t = f->tseitinTransformation(); }), nodes);
+	report("nnf", timed([&]() { n = t->nnf(); }), nodes);
+	report("flatCNF", timed([&]() { n->flatCNF(cnf); }), nodes);
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	cout << "  " << cnf.numVariables() << " variables, " << cnf.numClauses() << " clauses, "
+		<< cnf.numLiterals() << " literals, peak memory " << usage.ru_maxrss / 1024 << " MB" << endl;
+}
+
+static void usage(const char *program)
+{
+	cerr << "usage: " << program << " [family size]" << endl
+		<< "  runs every family at its default size, or the given one, families:";
+	for(const Family &family : families)
+		cerr << " " << family.name;
+	cerr << endl;
+}
+
+int main(int argc, char **argv)
+{
+	if(argc == 3)
+	{
+		for(const Family &family : families)
+			if(strcmp(family.name, argv[1]) == 0 && atoi(argv[2]) > 0)
+			{
+				run(family, atoi(argv[2]));
+				return 0;
+			}
+	}
+
+	if(argc != 1)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	// each family in a process of its own, so that the peak memory is its own
+	// and the parser starts from a clean state
+	int failed = 0;
+	for(const Family &family : families)
+	{
+		cout.flush();
+
+		pid_t child = fork();
+		if(child == 0)
+		{
+			run(family, family.size);
+			cout.flush();
+			_exit(0);
+		}
+
+		int status;
+		if(child < 0 || waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		{
+			cerr << family.name << " failed" << endl;
+			failed = 1;
+		}
+	}
+
+	return failed;
+}
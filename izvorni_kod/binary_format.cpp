@@ -0,0 +1,424 @@
+#include "binary_format.h"
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+// the first byte is not ASCII, so no formula text starts with the magic
+static const char MAGIC[4] = {'\x89', 'T', 'S', 'B'};
+static const uint32_t VERSION = 2;
+
+// The header of a record. fresh is, for a formula, the number of fresh atoms
+// its context had handed out, for clauses their first fresh variable; the
+// fresh atoms are named with the prefix at the end of the record.
+struct RecordHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t kind;
+	uint32_t fresh;
+	// bytes of the whole record, a multiple of 8
+	uint64_t size;
+	uint64_t prefixLength;
+	// formula: nodes, atom names, root, bytes of the names
+	// clauses: variables, clauses, literals, bytes of the names
+	uint64_t counts[4];
+};
+
+// an atom keeps the index of its name as op1
+struct NodeRecord
+{
+	uint32_t type;
+	uint32_t op1, op2;
+};
+
+// types by the code they are stored with, which does not change with the
+// order of Type
+static const Type nodeTypes[] = {T_TRUE, T_FALSE, T_ATOM, T_NOT, T_AND, T_OR, T_IMP, T_IFF};
+static const uint32_t NUM_NODE_TYPES = sizeof(nodeTypes) / sizeof(nodeTypes[0]);
+
+static uint32_t typeCode(Type t)
+{
+	switch(t)
+	{
+		case T_TRUE: return 0;
+		case T_FALSE: return 1;
+		case T_ATOM: return 2;
+		case T_NOT: return 3;
+		case T_AND: return 4;
+		case T_OR: return 5;
+		case T_IMP: return 6;
+		case T_IFF: return 7;
+	}
+
+	return NUM_NODE_TYPES;
+}
+
+static uint64_t aligned(uint64_t n)
+{
+	return (n + 7) & ~(uint64_t) 7;
+}
+
+// where the tables of a record start, as offsets from its header
+struct Layout
+{
+	// formula: nodes; clauses: clause offsets, then literals
+	uint64_t nodes, literals;
+	uint64_t nameOffsets, names, prefix, size;
+
+	Layout(const RecordHeader &h)
+	{
+		uint64_t numNames;
+
+		nodes = sizeof(RecordHeader);
+		if(h.kind == BinaryRecord::BR_FORMULA)
+		{
+			literals = nodes;
+			nameOffsets = nodes + aligned(h.counts[0] * sizeof(NodeRecord));
+			numNames = h.counts[1];
+		}
+		else
+		{
+			literals = nodes + (h.counts[1] + 1) * sizeof(uint64_t);
+			nameOffsets = literals + aligned(h.counts[2] * sizeof(Cnf::Literal));
+			numNames = h.counts[0];
+		}
+		names = nameOffsets + (numNames + 1) * sizeof(uint64_t);
+		prefix = names + aligned(h.counts[3]);
+		size = prefix + aligned(h.prefixLength);
+	}
+};
+
+//-----------------------------------------------------------------------------
+// BinaryRecord
+//-----------------------------------------------------------------------------
+BinaryRecord::BinaryRecord()
+	: _data(nullptr)
+{
+}
+
+BinaryRecord::Kind BinaryRecord::getKind() const
+{
+	return (Kind) ((const RecordHeader*) _data)->kind;
+}
+
+unsigned BinaryRecord::getFresh() const
+{
+	return ((const RecordHeader*) _data)->fresh;
+}
+
+string BinaryRecord::getPrefix() const
+{
+	const RecordHeader *h = (const RecordHeader*) _data;
+
+	return string(_data + Layout(*h).prefix, h->prefixLength);
+}
+
+// checks that name i lies within the names
+static bool validName(const uint64_t *offsets, uint64_t numNames, uint64_t bytes, uint64_t i)
+{
+	return i < numNames && offsets[i] <= offsets[i + 1] && offsets[i + 1] <= bytes;
+}
+
+// adds the formula to the pool; false if the record is damaged
+bool BinaryRecord::load(FormulaPool &pool, NodeId &root) const
+{
+	const RecordHeader &h = *(const RecordHeader*) _data;
+	Layout l(h);
+	const NodeRecord *nodes = (const NodeRecord*) (_data + l.nodes);
+	const uint64_t *nameOffsets = (const uint64_t*) (_data + l.nameOffsets);
+	const char *names = _data + l.names;
+	uint64_t numNodes = h.counts[0], numNames = h.counts[1];
+
+	if(h.kind != BR_FORMULA || h.counts[2] >= numNodes)
+		return false;
+
+	// operands come first, so their ids are known when a node is made
+	NodeList ids(numNodes);
+	for(uint64_t i = 0; i < numNodes; i++)
+	{
+		const NodeRecord &n = nodes[i];
+
+		if(n.type >= NUM_NODE_TYPES)
+			return false;
+
+		Type t = nodeTypes[n.type];
+		switch(t)
+		{
+			case T_TRUE:
+				ids[i] = pool.makeTrue();
+				break;
+			case T_FALSE:
+				ids[i] = pool.makeFalse();
+				break;
+			case T_ATOM:
+				if(!validName(nameOffsets, numNames, h.counts[3], n.op1))
+					return false;
+				ids[i] = pool.makeAtom(string(names + nameOffsets[n.op1], names + nameOffsets[n.op1 + 1]));
+				break;
+			case T_NOT:
+				if(n.op1 >= i)
+					return false;
+				ids[i] = pool.makeNot(ids[n.op1]);
+				break;
+			default:
+				if(n.op1 >= i || n.op2 >= i)
+					return false;
+				ids[i] = pool.make(t, ids[n.op1], ids[n.op2]);
+				break;
+		}
+	}
+
+	root = ids[h.counts[2]];
+	return true;
+}
+
+// adds the clauses to an empty clause set, with the same variable numbers;
+// false if the record is damaged
+bool BinaryRecord::load(Cnf &cnf) const
+{
+	const RecordHeader &h = *(const RecordHeader*) _data;
+	Layout l(h);
+	const uint64_t *offsets = (const uint64_t*) (_data + l.nodes);
+	const Cnf::Literal *literals = (const Cnf::Literal*) (_data + l.literals);
+	const uint64_t *nameOffsets = (const uint64_t*) (_data + l.nameOffsets);
+	const char *names = _data + l.names;
+	uint64_t numVariables = h.counts[0], numClauses = h.counts[1];
+
+	assert(cnf.numVariables() == 0 && cnf.numClauses() == 0);
+	if(h.kind != BR_CNF || numVariables > INT32_MAX || offsets[0] != 0 || offsets[numClauses] != h.counts[2])
+		return false;
+
+	cnf.addVariables(numVariables);
+	for(uint64_t v = 0; v < numVariables; v++)
+	{
+		if(!validName(nameOffsets, numVariables, h.counts[3], v))
+			return false;
+		cnf.setName(v + 1, string(names + nameOffsets[v], names + nameOffsets[v + 1]));
+	}
+
+	Cnf::Literal bound = (Cnf::Literal) numVariables;
+	for(uint64_t i = 0; i < numClauses; i++)
+	{
+		if(offsets[i] > offsets[i + 1] || offsets[i + 1] > h.counts[2])
+			return false;
+
+		const Cnf::Literal *begin = literals + offsets[i], *end = literals + offsets[i + 1];
+		for(const Cnf::Literal *p = begin; p != end; p++)
+			if(*p == 0 || *p > bound || *p < -bound)
+				return false;
+		cnf.addClause(begin, end);
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// BinaryReader
+//-----------------------------------------------------------------------------
+BinaryReader::BinaryReader(const char *data, size_t size)
+	: _next(data), _end(data + size), _failed(false)
+{
+}
+
+bool BinaryReader::isBinary(const char *data, size_t size)
+{
+	return size >= sizeof(MAGIC) && memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+// Moves to the next record. Only its header is checked here: that it is
+// whole and its tables fit in it. false at the end of the data and for a
+// damaged header, after which failed() is true.
+bool BinaryReader::next(BinaryRecord &record)
+{
+	if(_failed || _next == _end)
+		return false;
+
+	size_t left = _end - _next;
+	const RecordHeader *h = (const RecordHeader*) _next;
+
+	_failed = true;
+	if(left < sizeof(RecordHeader) || (uintptr_t) _next % 8 != 0)
+		return false;
+	if(memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 || h->version != VERSION)
+		return false;
+	if(h->kind != BinaryRecord::BR_FORMULA && h->kind != BinaryRecord::BR_CNF)
+		return false;
+
+	// no table is longer than the record, which keeps the layout from
+	// overflowing
+	if(h->size > left || h->prefixLength > left)
+		return false;
+	for(uint64_t count : h->counts)
+		if(count > left)
+			return false;
+	if(Layout(*h).size != h->size)
+		return false;
+
+	_failed = false;
+	record._data = _next;
+	_next += h->size;
+	return true;
+}
+
+bool BinaryReader::failed() const
+{
+	return _failed;
+}
+
+//-----------------------------------------------------------------------------
+// BinaryWriter
+//-----------------------------------------------------------------------------
+BinaryWriter::BinaryWriter(OutputBuffer &out)
+	: _out(out)
+{
+}
+
+void BinaryWriter::putBytes(const void *p, size_t n)
+{
+	_out.putString((const char*) p, n);
+}
+
+// the offsets of the names, the names and the padding after them
+void BinaryWriter::putNames(const vector<const string*> &names)
+{
+	uint64_t offset = 0;
+
+	putBytes(&offset, sizeof(offset));
+	for(const string *name : names)
+	{
+		offset += name->size();
+		putBytes(&offset, sizeof(offset));
+	}
+
+	for(const string *name : names)
+		_out.putString(*name);
+	putPadding(offset);
+}
+
+void BinaryWriter::putPrefix(const string &prefix)
+{
+	_out.putString(prefix);
+	putPadding(prefix.size());
+}
+
+// zeros up to the next multiple of 8 after n bytes
+void BinaryWriter::putPadding(uint64_t n)
+{
+	static const char zeros[8] = {};
+
+	putBytes(zeros, aligned(n) - n);
+}
+
+// writes the nodes under root; they get consecutive indices in the order of
+// the pool, which keeps operands before the nodes using them
+void BinaryWriter::write(const FormulaPool &pool, NodeId root, const TseitinContext &context)
+{
+	const uint32_t UNUSED = UINT32_MAX;
+	vector<uint32_t> index(root + 1, UNUSED);
+	vector<const string*> names;
+	uint64_t nameBytes = 0;
+	uint32_t numNodes = 0;
+
+	index[root] = 0;
+	for(NodeId n = root + 1; n-- > 0; )
+	{
+		if(index[n] == UNUSED)
+			continue;
+
+		switch(pool.getType(n))
+		{
+			case T_ATOM: case T_TRUE: case T_FALSE:
+				break;
+			case T_NOT:
+				index[pool.getOp(n)] = 0;
+				break;
+			default:
+				index[pool.getOp1(n)] = 0;
+				index[pool.getOp2(n)] = 0;
+				break;
+		}
+	}
+
+	for(NodeId n = 0; n <= root; n++)
+		if(index[n] != UNUSED)
+		{
+			index[n] = numNodes++;
+			if(pool.getType(n) == T_ATOM)
+			{
+				names.push_back(&pool.getId(n));
+				nameBytes += pool.getId(n).size();
+			}
+		}
+
+	RecordHeader h = {{MAGIC[0], MAGIC[1], MAGIC[2], MAGIC[3]}, VERSION, BinaryRecord::BR_FORMULA, context.numReserved(), 0,
+		context.getPrefix().size(), {numNodes, names.size(), index[root], nameBytes}};
+	h.size = Layout(h).size;
+	putBytes(&h, sizeof(h));
+
+	uint32_t atoms = 0;
+	for(NodeId n = 0; n <= root; n++)
+	{
+		if(index[n] == UNUSED)
+			continue;
+
+		Type t = pool.getType(n);
+		NodeRecord r = {typeCode(t), 0, 0};
+		switch(t)
+		{
+			case T_TRUE: case T_FALSE:
+				break;
+			case T_ATOM:
+				r.op1 = atoms++;
+				break;
+			case T_NOT:
+				r.op1 = index[pool.getOp(n)];
+				break;
+			default:
+				r.op1 = index[pool.getOp1(n)];
+				r.op2 = index[pool.getOp2(n)];
+				break;
+		}
+		putBytes(&r, sizeof(r));
+	}
+	putPadding(numNodes * sizeof(NodeRecord));
+
+	putNames(names);
+	putPrefix(context.getPrefix());
+}
+
+// writes the clauses; firstFresh is their first fresh variable, named with
+// the prefix of context
+void BinaryWriter::write(const Cnf &cnf, unsigned firstFresh, const TseitinContext &context)
+{
+	vector<const string*> names;
+	uint64_t nameBytes = 0;
+
+	for(unsigned v = 1; v <= cnf.numVariables(); v++)
+	{
+		names.push_back(&cnf.getName(v));
+		nameBytes += cnf.getName(v).size();
+	}
+
+	RecordHeader h = {{MAGIC[0], MAGIC[1], MAGIC[2], MAGIC[3]}, VERSION, BinaryRecord::BR_CNF, firstFresh, 0,
+		context.getPrefix().size(), {cnf.numVariables(), cnf.numClauses(), cnf.numLiterals(), nameBytes}};
+	h.size = Layout(h).size;
+	putBytes(&h, sizeof(h));
+
+	uint64_t offset = 0;
+	putBytes(&offset, sizeof(offset));
+	for(size_t i = 0; i < cnf.numClauses(); i++)
+	{
+		offset += cnf.clauseSize(i);
+		putBytes(&offset, sizeof(offset));
+	}
+
+	// the literals of all clauses are one block
+	if(cnf.numClauses() > 0)
+		putBytes(cnf.clauseBegin(0), cnf.numLiterals() * sizeof(Cnf::Literal));
+	putPadding(offset * sizeof(Cnf::Literal));
+
+	putNames(names);
+	putPrefix(context.getPrefix());
+}
@@ -0,0 +1,71 @@
+#ifndef _BINARY_FORMAT_H_
+#define _BINARY_FORMAT_H_
+
+#include "formula_pool.h"
+#include "output_buffer.h"
+
+// Versioned binary form of formula DAGs and clause sets. A file is a sequence
+// of records. Each starts with a header that gives its kind, its size, the
+// sizes of its tables and the fresh atoms it was made with, followed by:
+// - for a formula, its nodes, each with its type and the indices of its
+//   operands (of its name for an atom), operands before the nodes using
+//   them, and the names of its atoms
+// - for clauses, the offset of each clause in the literals, the literals and
+//   the names of the variables
+// Numbers are in the byte order of the machine and every table starts at a
+// multiple of 8 bytes, so a mapped file is used in place, without parsing.
+
+// One record of a file, read from memory that must stay mapped while the
+// record is used. The load functions check every index they follow, so a
+// damaged record is refused instead of read out of bounds.
+class BinaryRecord
+{
+public:
+	enum Kind { BR_FORMULA = 1, BR_CNF = 2 };
+
+	BinaryRecord();
+
+	Kind getKind() const;
+	unsigned getFresh() const;
+	std::string getPrefix() const;
+	bool load(FormulaPool &pool, NodeId &root) const;
+	bool load(Cnf &cnf) const;
+
+private:
+	friend class BinaryReader;
+	const char *_data;
+};
+
+class BinaryReader
+{
+public:
+	BinaryReader(const char *data, size_t size);
+
+	static bool isBinary(const char *data, size_t size);
+	bool next(BinaryRecord &record);
+	bool failed() const;
+
+private:
+	const char *_next, *_end;
+	bool _failed;
+};
+
+class BinaryWriter
+{
+public:
+	BinaryWriter(OutputBuffer &out);
+
+	void write(const FormulaPool &pool, NodeId root, const TseitinContext &context);
+	void write(const Cnf &cnf, unsigned firstFresh, const TseitinContext &context);
+
+private:
+	OutputBuffer &_out;
+
+	void putBytes(const void *p, size_t n);
+	void putNames(const std::vector<const std::string*> &names);
+	void putPrefix(const std::string &prefix);
+	void putPadding(uint64_t n);
+};
+
+
+#endif //_BINARY_FORMAT_H_
@@ -0,0 +1,175 @@
+#include "bit_evaluator.h"
+#include "thread_pool.h"
+#include <atomic>
+
+using namespace std;
+
+const unsigned BitEvaluator::WORDS;
+const unsigned BitEvaluator::LANES;
+const uint64_t BitEvaluator::NOT_FOUND;
+const uint64_t BitEvaluator::SEARCH_JOB_BLOCKS;
+
+// bit b of the numbers 0, ..., 63, for b < 6
+static const uint64_t lowBits[6] =
+{
+	0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+	0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL
+};
+
+// v fixes the order of the atoms, it must contain all atoms of the code
+BitEvaluator::BitEvaluator(const Bytecode &code, const Valuation &v)
+	: _numAtoms(v.size())
+{
+	assert(_numAtoms < 64 && "too many atoms to enumerate");
+
+	for(size_t i = 0; i < code.size(); i++)
+	{
+		Bytecode::Instruction in = code[i];
+
+		if(in.op == T_ATOM)
+			in.op1 = v.getBit(in.op1);
+		_program.push_back(in);
+	}
+
+	_slots.resize(_program.size() * WORDS);
+}
+
+uint64_t BitEvaluator::numValuations() const
+{
+	return 1ULL << _numAtoms;
+}
+
+// Returns the values of the formula under the valuations first, ...,
+// first + LANES - 1 in the order of Valuation::next. first must be a
+// multiple of LANES, lanes past numValuations() are 0.
+const uint64_t* BitEvaluator::eval(uint64_t first)
+{
+	for(size_t i = 0; i < _program.size(); i++)
+	{
+		const Bytecode::Instruction &in = _program[i];
+		uint64_t *r = &_slots[i * WORDS];
+		const uint64_t *a = &_slots[in.op1 * WORDS], *b = &_slots[in.op2 * WORDS];
+
+		switch(in.op)
+		{
+			case T_TRUE:
+				for(unsigned w = 0; w < WORDS; w++)
+					r[w] = ~0ULL;
+				break;
+			case T_FALSE:
+				for(unsigned w = 0; w < WORDS; w++)
+					r[w] = 0;
+				break;
+			case T_ATOM:
+				for(unsigned w = 0; w < WORDS; w++)
+				{
+					if(in.op1 < 6)
+						r[w] = lowBits[in.op1];
+					else
+						r[w] = (((first + 64 * w) >> in.op1) & 1) ? ~0ULL : 0;
+				}
+				break;
+			case T_NOT:
+				for(unsigned w = 0; w < WORDS; w++)
+					r[w] = ~a[w];
+				break;
+			case T_AND:
+				for(unsigned w = 0; w < WORDS; w++)
+					r[w] = a[w] & b[w];
+				break;
+			case T_OR:
+				for(unsigned w = 0; w < WORDS; w++)
+					r[w] = a[w] | b[w];
+				break;
+			case T_IMP:
+				for(unsigned w = 0; w < WORDS; w++)
+					r[w] = ~a[w] | b[w];
+				break;
+			case T_IFF:
+				for(unsigned w = 0; w < WORDS; w++)
+					r[w] = ~(a[w] ^ b[w]);
+				break;
+		}
+	}
+
+	uint64_t *res = &_slots[(_program.size() - 1) * WORDS];
+	uint64_t lanes = numValuations() - first;
+
+	if(lanes < LANES)
+	{
+		for(unsigned w = 0; w < WORDS; w++)
+		{
+			if(lanes >= 64 * (w + 1))
+				continue;
+			res[w] &= lanes > 64 * w ? (1ULL << (lanes - 64 * w)) - 1 : 0;
+		}
+	}
+
+	return res;
+}
+
+// returns the first of the given lanes of the block that has the value, or -1
+int BitEvaluator::find(const uint64_t *block, unsigned lanes, bool value)
+{
+	for(unsigned w = 0; w * 64 < lanes; w++)
+	{
+		uint64_t bits = value ? block[w] : ~block[w];
+
+		if(lanes < 64 * (w + 1))
+			bits &= (1ULL << (lanes - 64 * w)) - 1;
+		if(bits != 0)
+			return 64 * w + __builtin_ctzll(bits);
+	}
+
+	return -1;
+}
+
+// Returns the number of the first valuation, in the order of Valuation::next,
+// under which the code has the given value, or NOT_FOUND. With workers, the
+// valuations are split into chunks that share the highest bits of their
+// numbers and each chunk is a job. A job stops as soon as a valuation before
+// its next block is found by any job, so the result is the same as without
+// workers. It must not be called from a job of the same workers.
+uint64_t BitEvaluator::search(const Bytecode &code, const Valuation &v, bool value, ThreadPool *workers)
+{
+	uint64_t total = 1ULL << v.size();
+	uint64_t blocks = (total + LANES - 1) / LANES;
+	uint64_t chunks = 1;
+
+	// both are powers of two, so every chunk is whole blocks
+	if(workers != nullptr)
+		while(chunks < 16 * workers->numThreads() && blocks / (2 * chunks) >= SEARCH_JOB_BLOCKS)
+			chunks *= 2;
+
+	atomic<uint64_t> found(NOT_FOUND);
+
+	auto job = [&](size_t k)
+	{
+		BitEvaluator e(code, v);
+		uint64_t end = min(total, (k + 1) * (blocks / chunks) * LANES);
+
+		for(uint64_t first = k * (blocks / chunks) * LANES; first < end; first += LANES)
+		{
+			if(first > found.load(memory_order_relaxed))
+				return;
+
+			unsigned lanes = min<uint64_t>(LANES, total - first);
+			int j = find(e.eval(first), lanes, value);
+
+			if(j >= 0)
+			{
+				uint64_t n = first + j, old = found.load();
+				while(n < old && !found.compare_exchange_weak(old, n))
+					;
+				return;
+			}
+		}
+	};
+
+	if(chunks == 1)
+		job(0);
+	else
+		workers->run(chunks, job);
+
+	return found.load();
+}
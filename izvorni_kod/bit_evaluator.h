@@ -0,0 +1,37 @@
+#ifndef _BIT_EVALUATOR_H_
+#define _BIT_EVALUATOR_H_
+
+#include "bytecode.h"
+
+// Evaluates compiled formulas on LANES consecutive valuations at once (bit
+// slicing). Every instruction gets a block of WORDS words whose bit j is its value under the
+// j-th valuation of the block, so a connective is a few word operations
+// however many valuations there are. The loops over a block are simple
+// enough for the compiler to vectorize.
+class BitEvaluator
+{
+public:
+	static const unsigned WORDS = 8;
+	static const unsigned LANES = 64 * WORDS;
+	static const uint64_t NOT_FOUND = ~0ULL;
+	// smallest number of blocks worth a job of their own in search
+	static const uint64_t SEARCH_JOB_BLOCKS = 1 << 10;
+
+	BitEvaluator(const Bytecode &code, const Valuation &v);
+
+	uint64_t numValuations() const;
+	const uint64_t* eval(uint64_t first);
+
+	static int find(const uint64_t *block, unsigned lanes, bool value);
+	static uint64_t search(const Bytecode &code, const Valuation &v, bool value, ThreadPool *workers = nullptr);
+
+private:
+	// the code with the symbol of each atom replaced by its bit in the
+	// number of a valuation
+	std::vector<Bytecode::Instruction> _program;
+	std::vector<uint64_t> _slots;
+	unsigned _numAtoms;
+};
+
+
+#endif //_BIT_EVALUATOR_H_
@@ -0,0 +1,64 @@
+#include "bytecode.h"
+
+using namespace std;
+
+Bytecode::Bytecode(const BaseFormula *f)
+{
+	PostOrder order(f);
+
+	_code.reserve(order.size());
+	for(size_t i = 0; i < order.size(); i++)
+	{
+		Type t = order.node(i)->getType();
+
+		if(t == T_ATOM)
+			_code.push_back(Instruction{t, ((const Atom*) order.node(i))->getSymbol(), 0});
+		else if(t == T_TRUE || t == T_FALSE)
+			_code.push_back(Instruction{t, 0, 0});
+		else if(t == T_NOT)
+			_code.push_back(Instruction{t, (unsigned) order.op1(i), 0});
+		else
+			_code.push_back(Instruction{t, (unsigned) order.op1(i), (unsigned) order.op2(i)});
+	}
+
+	_slots.resize(_code.size());
+}
+
+bool Bytecode::eval(const Valuation &v)
+{
+	const Instruction *in = _code.data();
+	char *r = _slots.data();
+
+	for(size_t i = 0, n = _code.size(); i < n; i++)
+	{
+		switch(in[i].op)
+		{
+			case T_TRUE:
+				r[i] = true;
+				break;
+			case T_FALSE:
+				r[i] = false;
+				break;
+			case T_ATOM:
+				r[i] = v.getValue(in[i].op1);
+				break;
+			case T_NOT:
+				r[i] = !r[in[i].op1];
+				break;
+			case T_AND:
+				r[i] = r[in[i].op1] & r[in[i].op2];
+				break;
+			case T_OR:
+				r[i] = r[in[i].op1] | r[in[i].op2];
+				break;
+			case T_IMP:
+				r[i] = (!r[in[i].op1]) | r[in[i].op2];
+				break;
+			case T_IFF:
+				r[i] = r[in[i].op1] == r[in[i].op2];
+				break;
+		}
+	}
+
+	return r[_code.size() - 1];
+}
@@ -0,0 +1,42 @@
+#ifndef _BYTECODE_H_
+#define _BYTECODE_H_
+
+#include "prop_logic.h"
+
+// A formula compiled into a flat list of instructions in post-order. The
+// opcode of an instruction is the type of its node and the operands are the
+// numbers of earlier instructions, so evaluating it is a single loop over
+// the list. Compile a formula once to evaluate it under many valuations;
+// a Bytecode must not be evaluated by several threads at the same time.
+class Bytecode
+{
+public:
+	// an atom keeps its symbol in op1, unused operands are 0
+	struct Instruction
+	{
+		Type op;
+		unsigned op1, op2;
+	};
+
+	Bytecode(const BaseFormula *f);
+
+	size_t size() const
+	{
+		return _code.size();
+	}
+
+	const Instruction& operator[](size_t i) const
+	{
+		return _code[i];
+	}
+
+	bool eval(const Valuation &v);
+
+private:
+	std::vector<Instruction> _code;
+	// result of each instruction in the last evaluation
+	std::vector<char> _slots;
+};
+
+
+#endif //_BYTECODE_H_
@@ -0,0 +1,174 @@
+#include "cnf.h"
+#include <algorithm>
+
+using namespace std;
+
+Cnf::Cnf()
+	: _offsets(1, 0), _names(1), _indexed(0)
+{}
+
+// returns the variable of the atom with the given name, adding it if needed
+unsigned Cnf::getVariable(const string &name)
+{
+	for(; _indexed < numVariables(); _indexed++)
+		_variables.insert(make_pair(_names[_indexed + 1], _indexed + 1));
+
+	auto i = _variables.find(name);
+	if(i != _variables.end())
+		return i->second;
+
+	_names.push_back(name);
+	_variables.insert(make_pair(name, _names.size() - 1));
+	_indexed++;
+
+	return _names.size() - 1;
+}
+
+// adds n variables without names and returns the first of them, their names
+// must be set with setName before getVariable is called again
+unsigned Cnf::addVariables(unsigned n)
+{
+	_names.resize(_names.size() + n);
+
+	return _names.size() - n;
+}
+
+// names a variable added with addVariables, different variables can be
+// named at the same time
+void Cnf::setName(unsigned var, const string &name)
+{
+	_names[var] = name;
+}
+
+const string& Cnf::getName(unsigned var) const
+{
+	return _names[var];
+}
+
+unsigned Cnf::numVariables() const
+{
+	return _names.size() - 1;
+}
+
+size_t Cnf::numClauses() const
+{
+	return _offsets.size() - 1;
+}
+
+size_t Cnf::numLiterals() const
+{
+	return _literals.size();
+}
+
+// appends a literal to the clause that is being built
+void Cnf::addLiteral(Literal l)
+{
+	_literals.push_back(l);
+}
+
+void Cnf::endClause()
+{
+	_offsets.push_back(_literals.size());
+}
+
+void Cnf::addClause(const Literal *begin, const Literal *end)
+{
+	_literals.insert(_literals.end(), begin, end);
+	endClause();
+}
+
+// appends the clauses of cnf, whose literals must already refer to the
+// variables of this one
+void Cnf::append(const Cnf &cnf)
+{
+	size_t base = _literals.size();
+
+	_literals.insert(_literals.end(), cnf._literals.begin(), cnf._literals.end());
+	_offsets.reserve(_offsets.size() + cnf.numClauses());
+	for(size_t i = 1; i < cnf._offsets.size(); i++)
+		_offsets.push_back(base + cnf._offsets[i]);
+}
+
+// Replaces the clauses [first, middle) and [middle, numClauses()) with the
+// union of every pair of a clause from the first and one from the second range.
+// Only the operands are copied aside, the pairs are written in place into
+// space reserved for exactly all of them.
+void Cnf::makePairs(size_t first, size_t middle)
+{
+	size_t last = numClauses();
+	size_t n1 = middle - first, n2 = last - middle;
+	size_t length1 = _offsets[middle] - _offsets[first], length2 = _offsets[last] - _offsets[middle];
+	vector<Literal> literals(_literals.begin() + _offsets[first], _literals.end());
+	vector<size_t> offsets(_offsets.begin() + first, _offsets.end());
+	size_t base = offsets[0];
+
+	truncate(first);
+	_literals.reserve(_literals.size() + n2 * length1 + n1 * length2);
+	_offsets.reserve(_offsets.size() + n1 * n2);
+
+	for(size_t i = 0; i < n1; i++)
+		for(size_t j = n1; j < n1 + n2; j++)
+		{
+			_literals.insert(_literals.end(), literals.begin() + (offsets[i] - base), literals.begin() + (offsets[i + 1] - base));
+			_literals.insert(_literals.end(), literals.begin() + (offsets[j] - base), literals.begin() + (offsets[j + 1] - base));
+			endClause();
+		}
+}
+
+// appends l to each clause from first on, moving the literals back to front
+// so that no clause has to be copied aside
+void Cnf::addToClauses(size_t first, Literal l)
+{
+	size_t last = numClauses();
+
+	_literals.resize(_literals.size() + (last - first));
+	for(size_t i = last; i-- > first; )
+	{
+		size_t shift = i - first;
+		Literal *begin = _literals.data() + _offsets[i], *end = _literals.data() + _offsets[i + 1];
+
+		end[shift] = l;
+		move_backward(begin, end, end + shift);
+		_offsets[i + 1] += shift + 1;
+	}
+}
+
+// removes all clauses from the given one on, variables are kept
+void Cnf::truncate(size_t clauses)
+{
+	_literals.resize(_offsets[clauses]);
+	_offsets.resize(clauses + 1);
+}
+
+void Cnf::clear()
+{
+	_literals.clear();
+	_offsets.assign(1, 0);
+	_names.resize(1);
+	_variables.clear();
+	_indexed = 0;
+}
+
+void Cnf::print(ostream &ostr) const
+{
+	ostr << "[ ";
+	for(size_t i = 0; i < numClauses(); i++)
+	{
+		ostr << "[ ";
+		for(const Literal *l = clauseBegin(i); l != clauseEnd(i); l++)
+		{
+			if(*l < 0)
+				ostr << "¬" << _names[-*l] << " ";
+			else
+				ostr << _names[*l] << " ";
+		}
+		ostr << "] ";
+	}
+	ostr << " ]";
+}
+
+ostream& operator<<(ostream &ostr, const Cnf &cnf)
+{
+	cnf.print(ostr);
+	return ostr;
+}
@@ -0,0 +1,67 @@
+#ifndef _CNF_H_
+#define _CNF_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Clause set over variables numbered densely from 1. A literal is v or -v and
+// all literals are kept in one buffer: clause i spans the literals from
+// _offsets[i] to _offsets[i + 1]. Variable names are kept for printing.
+// Variables can also be added in bulk and named later, possibly from several
+// threads; they are found by name only once getVariable is called again.
+class Cnf
+{
+public:
+	typedef int Literal;
+
+	Cnf();
+
+	unsigned getVariable(const std::string &name);
+	unsigned addVariables(unsigned n);
+	void setName(unsigned var, const std::string &name);
+	const std::string& getName(unsigned var) const;
+	unsigned numVariables() const;
+	size_t numClauses() const;
+	size_t numLiterals() const;
+
+	void addLiteral(Literal l);
+	void endClause();
+	void addClause(const Literal *begin, const Literal *end);
+	void append(const Cnf &cnf);
+	void makePairs(size_t first, size_t middle);
+	void addToClauses(size_t first, Literal l);
+	void truncate(size_t clauses);
+	void clear();
+
+	const Literal* clauseBegin(size_t i) const
+	{
+		return _literals.data() + _offsets[i];
+	}
+
+	const Literal* clauseEnd(size_t i) const
+	{
+		return _literals.data() + _offsets[i + 1];
+	}
+
+	size_t clauseSize(size_t i) const
+	{
+		return _offsets[i + 1] - _offsets[i];
+	}
+
+	void print(std::ostream&) const;
+
+private:
+	std::vector<Literal> _literals;
+	std::vector<size_t> _offsets;
+	std::vector<std::string> _names;
+	std::unordered_map<std::string, unsigned> _variables;
+	// number of variables that are in _variables
+	unsigned _indexed;
+};
+
+std::ostream& operator<<(std::ostream&, const Cnf&);
+
+
+#endif //_CNF_H_
@@ -0,0 +1,332 @@
+#include "cnf_simplifier.h"
+#include <algorithm>
+
+using namespace std;
+
+const size_t CnfSimplifier::MAX_RESOLUTIONS;
+const unsigned CnfSimplifier::MAX_RESOLVENT;
+
+// the clauses are taken over from cnf, which gets the simplified ones in run
+CnfSimplifier::CnfSimplifier(Cnf &cnf)
+	: _cnf(cnf), _occurs(2 * cnf.numVariables()), _frozen(cnf.numVariables() + 1, false),
+	  _empty(false), _removedClauses(0), _removedLiterals(0), _eliminated(0)
+{
+	vector<Literal> lits;
+
+	_lits.reserve(cnf.numLiterals());
+	_clauses.reserve(cnf.numClauses());
+
+	for(size_t i = 0; i < cnf.numClauses(); i++)
+	{
+		lits.assign(cnf.clauseBegin(i), cnf.clauseEnd(i));
+		if(!addClause(lits))
+			_removedClauses++;
+	}
+}
+
+// a frozen variable is not eliminated, so models keep its value
+void CnfSimplifier::freeze(unsigned var)
+{
+	_frozen[var] = true;
+}
+
+// simplifies the clauses and puts them back into the Cnf, in their order
+// with resolvents after them
+void CnfSimplifier::run(bool eliminate)
+{
+	for(unsigned c = 0; c < _clauses.size(); c++)
+		enqueue(c);
+	subsume();
+
+	if(eliminate && !_empty)
+	{
+		// variables with few occurrences first, they are the cheapest
+		vector<unsigned> vars;
+		for(unsigned v = 1; v <= _cnf.numVariables(); v++)
+			if(!_frozen[v])
+				vars.push_back(v);
+
+		vector<size_t> cost(_cnf.numVariables() + 1);
+		for(unsigned v : vars)
+			cost[v] = _occurs[2 * (v - 1)].size() * _occurs[2 * (v - 1) + 1].size();
+		stable_sort(vars.begin(), vars.end(), [&cost](unsigned a, unsigned b)
+		{
+			return cost[a] < cost[b];
+		});
+
+		for(size_t i = 0; i < vars.size() && !_empty; i++)
+			if(this->eliminate(vars[i]))
+				subsume();
+	}
+
+	_cnf.truncate(0);
+	if(_empty)
+	{
+		_cnf.endClause();
+		return;
+	}
+
+	for(unsigned c = 0; c < _clauses.size(); c++)
+		if(!_clauses[c].deleted)
+			_cnf.addClause(begin(c), end(c));
+}
+
+size_t CnfSimplifier::numRemovedClauses() const
+{
+	return _removedClauses;
+}
+
+size_t CnfSimplifier::numRemovedLiterals() const
+{
+	return _removedLiterals;
+}
+
+unsigned CnfSimplifier::numEliminated() const
+{
+	return _eliminated;
+}
+
+//-----------------------------------------------------------------------------
+// Clauses
+//-----------------------------------------------------------------------------
+// Sorts lits, drops duplicates and adds them as a clause. Returns false
+// if the clause is a tautology and was not added.
+bool CnfSimplifier::addClause(vector<Literal> &lits)
+{
+	sort(lits.begin(), lits.end(), [](Literal a, Literal b)
+	{
+		return index(a) < index(b);
+	});
+
+	size_t j = 0;
+	for(size_t i = 0; i < lits.size(); i++)
+	{
+		if(j > 0 && lits[i] == -lits[j - 1])
+			return false;
+		if(j == 0 || lits[i] != lits[j - 1])
+			lits[j++] = lits[i];
+	}
+
+	_removedLiterals += lits.size() - j;
+	lits.resize(j);
+
+	unsigned c = _clauses.size();
+	uint64_t sig = 0;
+	for(Literal l : lits)
+	{
+		sig |= signature(l);
+		_occurs[index(l)].push_back(c);
+	}
+
+	_clauses.push_back(Clause{_lits.size(), (unsigned) lits.size(), sig, false});
+	_lits.insert(_lits.end(), lits.begin(), lits.end());
+
+	if(lits.empty())
+		_empty = true;
+
+	return true;
+}
+
+void CnfSimplifier::removeClause(unsigned c)
+{
+	_clauses[c].deleted = true;
+	_removedClauses++;
+}
+
+// removes the literal l from clause c
+void CnfSimplifier::strengthen(unsigned c, Literal l)
+{
+	Clause &cl = _clauses[c];
+	Literal *lits = _lits.data() + cl.begin;
+
+	cl.size = remove(lits, lits + cl.size, l) - lits;
+	cl.signature = 0;
+	for(unsigned k = 0; k < cl.size; k++)
+		cl.signature |= signature(lits[k]);
+
+	vector<unsigned> &occ = _occurs[index(l)];
+	occ.erase(find(occ.begin(), occ.end(), c));
+
+	_removedLiterals++;
+	if(cl.size == 0)
+		_empty = true;
+
+	enqueue(c);
+}
+
+void CnfSimplifier::enqueue(unsigned c)
+{
+	if(c >= _queued.size())
+		_queued.resize(c + 1, false);
+
+	if(!_queued[c])
+	{
+		_queued[c] = true;
+		_queue.push_back(c);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Subsumption
+//-----------------------------------------------------------------------------
+// Returns true if c subsumes d, or if c with the literal flipped negated
+// does; then d can drop -flipped. flipped is 0 for plain subsumption.
+bool CnfSimplifier::subsumes(unsigned c, unsigned d, Literal &flipped) const
+{
+	const Literal *i = begin(c), *j = begin(d);
+	const Literal *iend = end(c), *jend = end(d);
+
+	flipped = 0;
+	for(; i != iend; i++)
+	{
+		while(j != jend && index(*j) >> 1 < index(*i) >> 1)
+			j++;
+		if(j == jend || index(*j) >> 1 != index(*i) >> 1)
+			return false;
+
+		if(*j != *i)
+		{
+			if(flipped != 0)
+				return false;
+			flipped = *i;
+		}
+		j++;
+	}
+
+	return true;
+}
+
+// Uses every queued clause to remove the clauses it subsumes and strengthen
+// the ones it subsumes with one literal flipped. The candidates contain the
+// variable of the clause with the fewest occurrences.
+void CnfSimplifier::subsume()
+{
+	vector<unsigned> candidates;
+
+	while(!_queue.empty() && !_empty)
+	{
+		unsigned c = _queue.back();
+		_queue.pop_back();
+		_queued[c] = false;
+
+		if(_clauses[c].deleted)
+			continue;
+
+		Literal best = 0;
+		size_t fewest = SIZE_MAX;
+		for(const Literal *l = begin(c); l != end(c); l++)
+		{
+			size_t n = _occurs[index(*l)].size() + _occurs[index(-*l)].size();
+			if(n < fewest)
+			{
+				fewest = n;
+				best = *l;
+			}
+		}
+
+		candidates = _occurs[index(best)];
+		candidates.insert(candidates.end(), _occurs[index(-best)].begin(), _occurs[index(-best)].end());
+
+		for(unsigned d : candidates)
+		{
+			const Clause &cd = _clauses[d];
+			Literal flipped;
+
+			if(d == c || cd.deleted || cd.size < _clauses[c].size || (_clauses[c].signature & ~cd.signature) != 0)
+				continue;
+			if(!subsumes(c, d, flipped))
+				continue;
+
+			if(flipped == 0)
+				removeClause(d);
+			else
+				strengthen(d, -flipped);
+
+			if(_clauses[c].deleted || _empty)
+				break;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Variable elimination
+//-----------------------------------------------------------------------------
+// sets clauses to the clauses containing l that are not deleted, and drops
+// the deleted ones from its list
+void CnfSimplifier::liveOccurrences(Literal l, vector<unsigned> &clauses)
+{
+	vector<unsigned> &occ = _occurs[index(l)];
+
+	occ.erase(remove_if(occ.begin(), occ.end(), [this](unsigned c)
+	{
+		return _clauses[c].deleted;
+	}), occ.end());
+
+	clauses = occ;
+}
+
+// sets res to the resolvent of c and d on var, returns false if it is a
+// tautology
+bool CnfSimplifier::resolve(unsigned c, unsigned d, unsigned var, vector<Literal> &res) const
+{
+	res.clear();
+
+	for(const Literal *l = begin(c); l != end(c); l++)
+		if((unsigned) abs(*l) != var)
+			res.push_back(*l);
+
+	for(const Literal *l = begin(d); l != end(d); l++)
+	{
+		if((unsigned) abs(*l) == var)
+			continue;
+		if(find(begin(c), end(c), -*l) != end(c))
+			return false;
+		if(find(begin(c), end(c), *l) == end(c))
+			res.push_back(*l);
+	}
+
+	return true;
+}
+
+// Replaces the clauses of var by all their resolvents on var if there are
+// no more of them than clauses removed and none is too long.
+bool CnfSimplifier::eliminate(unsigned var)
+{
+	vector<unsigned> pos, neg;
+	liveOccurrences(var, pos);
+	liveOccurrences(-(Literal) var, neg);
+
+	if((pos.empty() && neg.empty()) || pos.size() * neg.size() > MAX_RESOLUTIONS)
+		return false;
+
+	vector<vector<Literal>> resolvents;
+	vector<Literal> res;
+
+	for(unsigned c : pos)
+		for(unsigned d : neg)
+		{
+			if(!resolve(c, d, var, res))
+				continue;
+			if(res.size() > MAX_RESOLVENT || resolvents.size() == pos.size() + neg.size())
+				return false;
+
+			resolvents.push_back(res);
+		}
+
+	for(unsigned c : pos)
+		removeClause(c);
+	for(unsigned c : neg)
+		removeClause(c);
+
+	// resolve has left out the tautologies
+	for(vector<Literal> &r : resolvents)
+	{
+		addClause(r);
+		enqueue(_clauses.size() - 1);
+	}
+
+	_removedClauses -= resolvents.size();
+	_eliminated++;
+
+	return true;
+}
@@ -0,0 +1,90 @@
+#ifndef _CNF_SIMPLIFIER_H_
+#define _CNF_SIMPLIFIER_H_
+
+#include "cnf.h"
+#include <cstdint>
+
+// Shrinks the clauses of a Cnf before they are written or solved. Duplicate
+// literals and tautological clauses are dropped, clauses subsumed by another
+// are removed and clauses are strengthened by self-subsuming resolution; the
+// candidates are found through occurrence lists and filtered by 64-bit
+// signatures of the variables of a clause. Optionally, variables that are
+// not frozen are eliminated by resolution when that does not add clauses.
+// The result is equisatisfiable, and every model of it can be extended to
+// one of the input with the same values of the frozen variables. Variables
+// keep their numbers.
+class CnfSimplifier
+{
+public:
+	// limits of bounded variable elimination: the number of pairs of clauses
+	// resolved for one variable and the length of a resolvent
+	static const size_t MAX_RESOLUTIONS = 400;
+	static const unsigned MAX_RESOLVENT = 20;
+
+	CnfSimplifier(Cnf &cnf);
+
+	void freeze(unsigned var);
+	void run(bool eliminate = false);
+
+	size_t numRemovedClauses() const;
+	size_t numRemovedLiterals() const;
+	unsigned numEliminated() const;
+
+private:
+	typedef Cnf::Literal Literal;
+
+	// the literals of a clause are sorted by variable
+	struct Clause
+	{
+		size_t begin;
+		unsigned size;
+		uint64_t signature;
+		bool deleted;
+	};
+
+	Cnf &_cnf;
+	std::vector<Literal> _lits;
+	std::vector<Clause> _clauses;
+	// clauses of each literal, deleted clauses are dropped lazily
+	std::vector<std::vector<unsigned>> _occurs;
+	std::vector<char> _frozen;
+	// clauses that may subsume or strengthen others
+	std::vector<unsigned> _queue;
+	std::vector<char> _queued;
+	bool _empty;
+	size_t _removedClauses, _removedLiterals;
+	unsigned _eliminated;
+
+	static unsigned index(Literal l)
+	{
+		return 2 * ((l < 0 ? -l : l) - 1) + (l < 0);
+	}
+
+	static uint64_t signature(Literal l)
+	{
+		return 1ULL << ((l < 0 ? -l : l) & 63);
+	}
+
+	const Literal* begin(unsigned c) const
+	{
+		return _lits.data() + _clauses[c].begin;
+	}
+
+	const Literal* end(unsigned c) const
+	{
+		return _lits.data() + _clauses[c].begin + _clauses[c].size;
+	}
+
+	bool addClause(std::vector<Literal> &lits);
+	void removeClause(unsigned c);
+	void strengthen(unsigned c, Literal l);
+	void enqueue(unsigned c);
+	bool subsumes(unsigned c, unsigned d, Literal &flipped) const;
+	void subsume();
+	void liveOccurrences(Literal l, std::vector<unsigned> &clauses);
+	bool resolve(unsigned c, unsigned d, unsigned var, std::vector<Literal> &res) const;
+	bool eliminate(unsigned var);
+};
+
+
+#endif //_CNF_SIMPLIFIER_H_
@@ -0,0 +1,61 @@
+#include "dimacs.h"
+
+using namespace std;
+
+DimacsWriter::DimacsWriter(int fd, size_t bufferSize)
+	: _out(fd, bufferSize)
+{}
+
+// writes a comment line, e.g. to separate the instances of a stream
+void DimacsWriter::comment(const string &text)
+{
+	_out.putString("c ", 2);
+	_out.putString(text);
+	_out.putString("\n", 1);
+}
+
+// writes the "p cnf" header and the clauses, each ended with 0, and the
+// names of the variables as comment lines if names is set; the buffer is
+// only written out when it fills up, the rest by flush. Returns false if a
+// write has failed so far.
+bool DimacsWriter::write(const Cnf &cnf, bool names)
+{
+	if(names)
+	{
+		for(unsigned v = 1; v <= cnf.numVariables(); v++)
+		{
+			const string &name = cnf.getName(v);
+
+			_out.putString("c ", 2);
+			_out.putInt(v);
+			_out.putString(" ", 1);
+			_out.putString(name.data(), name.size());
+			_out.putString("\n", 1);
+		}
+	}
+
+	_out.putString("p cnf ", 6);
+	_out.putInt(cnf.numVariables());
+	_out.putString(" ", 1);
+	_out.putInt(cnf.numClauses());
+	_out.putString("\n", 1);
+
+	for(size_t i = 0; i < cnf.numClauses(); i++)
+	{
+		for(const Cnf::Literal *l = cnf.clauseBegin(i); l != cnf.clauseEnd(i); l++)
+		{
+			_out.putInt(*l);
+			_out.putChar(' ');
+		}
+		_out.reserve(2);
+		_out.putChar('0');
+		_out.putChar('\n');
+	}
+
+	return !_out.failed();
+}
+
+bool DimacsWriter::flush()
+{
+	return _out.flush();
+}
@@ -0,0 +1,23 @@
+#ifndef _DIMACS_H_
+#define _DIMACS_H_
+
+#include "cnf.h"
+#include "output_buffer.h"
+
+// Writes clause sets in DIMACS format straight to a file descriptor through
+// an OutputBuffer.
+class DimacsWriter
+{
+public:
+	DimacsWriter(int fd, size_t bufferSize = 1 << 20);
+
+	void comment(const std::string &text);
+	bool write(const Cnf &cnf, bool names = false);
+	bool flush();
+
+private:
+	OutputBuffer _out;
+};
+
+
+#endif //_DIMACS_H_
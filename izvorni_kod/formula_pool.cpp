@@ -0,0 +1,1179 @@
+#include "formula_pool.h"
+#include "thread_pool.h"
+#include "formula_writer.h"
+#include <algorithm>
+
+using namespace std;
+
+// flags used by passes that need a node, its negation or both; the Tseitin
+// encodings also mark the connectives that get no variable of their own: an
+// And or Or node joined into its only parent of the same type (P_JOINED) and
+// an Or node that is only a conjunct at the top, so a clause itself (P_TOP)
+enum Polarity { P_POS = 1, P_NEG = 2, P_JOINED = 4, P_TOP = 8 };
+
+static inline void addClause(Cnf &cnf, initializer_list<Cnf::Literal> clause)
+{
+	cnf.addClause(clause.begin(), clause.end());
+}
+
+static inline size_t hashNode(Type t, NodeId op1, NodeId op2)
+{
+	uint64_t h = ((uint64_t) op1 << 32 | op2) * 0x9e3779b97f4a7c15ULL;
+
+	return (size_t) (h >> 29) ^ ((size_t) t * 0x85ebca6bU);
+}
+
+// sums and products of estimates stop at SIZE_MAX instead of wrapping
+static inline size_t addBounded(size_t a, size_t b)
+{
+	return a > SIZE_MAX - b ? SIZE_MAX : a + b;
+}
+
+static inline size_t mulBounded(size_t a, size_t b)
+{
+	return a != 0 && b > SIZE_MAX / a ? SIZE_MAX : a * b;
+}
+
+//-----------------------------------------------------------------------------
+// Construction
+//-----------------------------------------------------------------------------
+const NodeId FormulaPool::NONE;
+const NodeId FormulaPool::TSEITIN_JOB_NODES;
+const size_t FormulaPool::FLAT_CNF_BUDGET;
+
+// fresh atoms are numbered by the given context, or by one of the pool
+FormulaPool::FormulaPool(TseitinContext *context)
+	: _table(1024, NONE), _context(context != nullptr ? context : &_ownContext)
+{
+	make(T_TRUE, 0, 0);
+	make(T_FALSE, 0, 0);
+}
+
+NodeId FormulaPool::makeTrue() const
+{
+	return 0;
+}
+
+NodeId FormulaPool::makeFalse() const
+{
+	return 1;
+}
+
+NodeId FormulaPool::makeAtom(const string &id)
+{
+	auto i = _atoms.find(id);
+	if(i != _atoms.end())
+		return i->second;
+
+	_names.push_back(id);
+	NodeId atom = make(T_ATOM, _names.size() - 1, 0);
+	_atoms.insert(make_pair(id, atom));
+
+	return atom;
+}
+
+NodeId FormulaPool::makeNot(NodeId op)
+{
+	return make(T_NOT, op, 0);
+}
+
+NodeId FormulaPool::makeAnd(NodeId op1, NodeId op2)
+{
+	return make(T_AND, op1, op2);
+}
+
+NodeId FormulaPool::makeOr(NodeId op1, NodeId op2)
+{
+	return make(T_OR, op1, op2);
+}
+
+NodeId FormulaPool::makeImp(NodeId op1, NodeId op2)
+{
+	return make(T_IMP, op1, op2);
+}
+
+NodeId FormulaPool::makeIff(NodeId op1, NodeId op2)
+{
+	return make(T_IFF, op1, op2);
+}
+
+// returns the existing node with the given type and operands or appends a new one
+NodeId FormulaPool::make(Type t, NodeId op1, NodeId op2)
+{
+	size_t mask = _table.size() - 1;
+	size_t i = hashNode(t, op1, op2) & mask;
+
+	for(; _table[i] != NONE; i = (i + 1) & mask)
+	{
+		const Node &n = _nodes[_table[i]];
+		if(n.type == t && n.op1 == op1 && n.op2 == op2)
+			return _table[i];
+	}
+
+	NodeId id = _nodes.size();
+	_nodes.push_back(Node{t, op1, op2});
+	_table[i] = id;
+
+	if(2 * _nodes.size() > _table.size())
+		rehash();
+
+	return id;
+}
+
+void FormulaPool::rehash()
+{
+	_table.assign(2 * _table.size(), NONE);
+	size_t mask = _table.size() - 1;
+
+	for(NodeId id = 0; id < _nodes.size(); id++)
+	{
+		const Node &n = _nodes[id];
+		size_t i = hashNode(n.type, n.op1, n.op2) & mask;
+
+		while(_table[i] != NONE)
+			i = (i + 1) & mask;
+
+		_table[i] = id;
+	}
+}
+
+NodeId FormulaPool::freshAtom()
+{
+	string id;
+
+	do
+	{
+		id = _context->getName(_context->reserve(1));
+	} while(_atoms.find(id) != _atoms.end());
+
+	return makeAtom(id);
+}
+
+// Reserves the numbers of n fresh atoms and returns the first, so that the
+// names of first, ..., first + n - 1 are not used by any atom of the pool and
+// can be made without looking them up.
+unsigned FormulaPool::reserveFresh(unsigned n)
+{
+	vector<unsigned> used;
+	unsigned k;
+
+	for(const string &name : _names)
+		if(_context->parseName(name, k))
+			used.push_back(k);
+	sort(used.begin(), used.end());
+
+	// a block that holds a used name is left unused
+	unsigned first;
+	do
+	{
+		first = _context->reserve(n);
+	} while(lower_bound(used.begin(), used.end(), first) < lower_bound(used.begin(), used.end(), first + n));
+
+	return first;
+}
+
+void FormulaPool::clear()
+{
+	vector<Node>().swap(_nodes);
+	vector<string>().swap(_names);
+	unordered_map<string, NodeId>().swap(_atoms);
+	_table.assign(1024, NONE);
+	if(_context == &_ownContext)
+		_ownContext.reset();
+
+	make(T_TRUE, 0, 0);
+	make(T_FALSE, 0, 0);
+}
+
+//-----------------------------------------------------------------------------
+// Access
+//-----------------------------------------------------------------------------
+Type FormulaPool::getType(NodeId n) const
+{
+	return _nodes[n].type;
+}
+
+NodeId FormulaPool::getOp(NodeId n) const
+{
+	return _nodes[n].op1;
+}
+
+NodeId FormulaPool::getOp1(NodeId n) const
+{
+	return _nodes[n].op1;
+}
+
+NodeId FormulaPool::getOp2(NodeId n) const
+{
+	return _nodes[n].op2;
+}
+
+const string& FormulaPool::getId(NodeId n) const
+{
+	return _names[_nodes[n].op1];
+}
+
+// returns true if a type of the node is T_NOT, T_ATOM, T_TRUE or T_FALSE
+bool FormulaPool::isNATF(NodeId n) const
+{
+	Type t = _nodes[n].type;
+
+	return t == T_TRUE || t == T_FALSE || t == T_ATOM || t == T_NOT;
+}
+
+size_t FormulaPool::size() const
+{
+	return _nodes.size();
+}
+
+//-----------------------------------------------------------------------------
+// Conversion from and to Formula
+//-----------------------------------------------------------------------------
+NodeId FormulaPool::import(const Formula &f)
+{
+	unordered_map<const BaseFormula*, NodeId> ids;
+	vector<const BaseFormula*> stack(1, f.get());
+
+	while(!stack.empty())
+	{
+		const BaseFormula *g = stack.back();
+		if(ids.find(g) != ids.end())
+		{
+			stack.pop_back();
+			continue;
+		}
+
+		// operands are imported first, g is visited again once they are done
+		const BaseFormula *op1 = nullptr, *op2 = nullptr;
+		if(g->getType() == T_NOT)
+			op1 = ((const UnaryConnective*) g)->getOp().get();
+		else if(g->getType() != T_ATOM && g->getType() != T_TRUE && g->getType() != T_FALSE)
+		{
+			op1 = ((const BinaryConnective*) g)->getOp1().get();
+			op2 = ((const BinaryConnective*) g)->getOp2().get();
+		}
+
+		auto id1 = op1 ? ids.find(op1) : ids.end();
+		auto id2 = op2 ? ids.find(op2) : ids.end();
+		bool ready = true;
+
+		if(op2 && id2 == ids.end())
+		{
+			stack.push_back(op2);
+			ready = false;
+		}
+		if(op1 && id1 == ids.end())
+		{
+			stack.push_back(op1);
+			ready = false;
+		}
+		if(!ready)
+			continue;
+
+		stack.pop_back();
+
+		switch(g->getType())
+		{
+			case T_TRUE:
+				ids[g] = makeTrue();
+				break;
+			case T_FALSE:
+				ids[g] = makeFalse();
+				break;
+			case T_ATOM:
+				ids[g] = makeAtom(((const Atom*) g)->getId());
+				break;
+			case T_NOT:
+				ids[g] = makeNot(id1->second);
+				break;
+			default:
+				ids[g] = make(g->getType(), id1->second, id2->second);
+				break;
+		}
+	}
+
+	return ids[f.get()];
+}
+
+Formula FormulaPool::toFormula(NodeId root) const
+{
+	vector<Formula> res(root + 1);
+	vector<bool> reach(root + 1, false);
+	reach[root] = true;
+
+	for(NodeId i = root + 1; i-- > 0; )
+	{
+		if(!reach[i])
+			continue;
+
+		const Node &n = _nodes[i];
+		if(n.type == T_NOT)
+			reach[n.op1] = true;
+		else if(n.type != T_ATOM && n.type != T_TRUE && n.type != T_FALSE)
+			reach[n.op1] = reach[n.op2] = true;
+	}
+
+	for(NodeId i = 0; i <= root; i++)
+	{
+		if(!reach[i])
+			continue;
+
+		const Node &n = _nodes[i];
+		switch(n.type)
+		{
+			case T_TRUE:
+				res[i] = FormulaFactory::makeTrue();
+				break;
+			case T_FALSE:
+				res[i] = FormulaFactory::makeFalse();
+				break;
+			case T_ATOM:
+				res[i] = FormulaFactory::makeAtom(_names[n.op1]);
+				break;
+			case T_NOT:
+				res[i] = FormulaFactory::makeNot(res[n.op1]);
+				break;
+			case T_AND:
+				res[i] = FormulaFactory::makeAnd(res[n.op1], res[n.op2]);
+				break;
+			case T_OR:
+				res[i] = FormulaFactory::makeOr(res[n.op1], res[n.op2]);
+				break;
+			case T_IMP:
+				res[i] = FormulaFactory::makeImp(res[n.op1], res[n.op2]);
+				break;
+			case T_IFF:
+				res[i] = FormulaFactory::makeIff(res[n.op1], res[n.op2]);
+				break;
+		}
+	}
+
+	return res[root];
+}
+
+//-----------------------------------------------------------------------------
+// Transformations
+//-----------------------------------------------------------------------------
+NodeId FormulaPool::simplify(NodeId root)
+{
+	vector<bool> reach(root + 1, false);
+	reach[root] = true;
+
+	for(NodeId i = root + 1; i-- > 0; )
+	{
+		if(!reach[i] || (isNATF(i) && _nodes[i].type != T_NOT))
+			continue;
+
+		reach[_nodes[i].op1] = true;
+		if(_nodes[i].type != T_NOT)
+			reach[_nodes[i].op2] = true;
+	}
+
+	NodeList res(root + 1, NONE);
+	for(NodeId i = 0; i <= root; i++)
+	{
+		if(!reach[i])
+			continue;
+
+		// _nodes may grow, so the node is copied
+		Node n = _nodes[i];
+		Type t1 = T_ATOM, t2 = T_ATOM;
+		NodeId s1 = NONE, s2 = NONE;
+
+		if(n.type == T_NOT || !isNATF(i))
+		{
+			s1 = res[n.op1];
+			t1 = _nodes[s1].type;
+		}
+		if(!isNATF(i))
+		{
+			s2 = res[n.op2];
+			t2 = _nodes[s2].type;
+		}
+
+		switch(n.type)
+		{
+			case T_TRUE:
+			case T_FALSE:
+			case T_ATOM:
+				res[i] = i;
+				break;
+			case T_NOT:
+				if(t1 == T_FALSE)
+					res[i] = makeTrue();
+				else if(t1 == T_TRUE)
+					res[i] = makeFalse();
+				else
+					res[i] = makeNot(s1);
+				break;
+			case T_AND:
+				if(t1 == T_TRUE)
+					res[i] = s2;
+				else if(t2 == T_TRUE)
+					res[i] = s1;
+				else if(t1 == T_FALSE || t2 == T_FALSE)
+					res[i] = makeFalse();
+				else
+					res[i] = makeAnd(s1, s2);
+				break;
+			case T_OR:
+				if(t1 == T_TRUE || t2 == T_TRUE)
+					res[i] = makeTrue();
+				else if(t1 == T_FALSE)
+					res[i] = s2;
+				else if(t2 == T_FALSE)
+					res[i] = s1;
+				else
+					res[i] = makeOr(s1, s2);
+				break;
+			case T_IMP:
+				if(t2 == T_TRUE || t1 == T_FALSE)
+					res[i] = makeTrue();
+				else if(t1 == T_TRUE)
+					res[i] = s2;
+				else if(t2 == T_FALSE)
+					res[i] = makeNot(s1);
+				else
+					res[i] = makeImp(s1, s2);
+				break;
+			case T_IFF:
+				if(t1 == T_FALSE && t2 == T_FALSE)
+					res[i] = makeTrue();
+				else if(t1 == T_TRUE)
+					res[i] = s2;
+				else if(t2 == T_TRUE)
+					res[i] = s1;
+				else if(t1 == T_FALSE)
+					res[i] = makeNot(s2);
+				else if(t2 == T_FALSE)
+					res[i] = makeNot(s1);
+				else
+					res[i] = makeIff(s1, s2);
+				break;
+		}
+	}
+
+	return res[root];
+}
+
+NodeId FormulaPool::pushNegation(NodeId root)
+{
+	return rewriteNegations(root, false);
+}
+
+NodeId FormulaPool::nnf(NodeId root)
+{
+	return rewriteNegations(root, true);
+}
+
+// Pushes negations down to the atoms, turning implications into disjunctions.
+// Equivalences are kept (pushNegation) or expanded (nnf). The first loop
+// records for each node whether its rewritten form, the rewritten form of its
+// negation or both are needed, and the second loop builds exactly those.
+NodeId FormulaPool::rewriteNegations(NodeId root, bool expandIff)
+{
+	vector<char> need(root + 1, 0);
+	need[root] = P_POS;
+
+	for(NodeId i = root + 1; i-- > 0; )
+	{
+		const Node &n = _nodes[i];
+		bool pos = need[i] & P_POS, neg = need[i] & P_NEG;
+
+		switch(n.type)
+		{
+			case T_NOT:
+				need[n.op1] |= (pos ? P_NEG : 0) | (neg ? P_POS : 0);
+				break;
+			case T_AND:
+			case T_OR:
+				need[n.op1] |= need[i];
+				need[n.op2] |= need[i];
+				break;
+			case T_IMP:
+				need[n.op1] |= (pos ? P_NEG : 0) | (neg ? P_POS : 0);
+				need[n.op2] |= need[i];
+				break;
+			case T_IFF:
+				if(expandIff && need[i])
+				{
+					need[n.op1] |= P_POS | P_NEG;
+					need[n.op2] |= P_POS | P_NEG;
+				}
+				else
+				{
+					need[n.op1] |= (pos ? P_POS : 0) | (neg ? P_NEG : 0);
+					need[n.op2] |= need[i] ? P_POS : 0;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	NodeList pos(root + 1, NONE), neg(root + 1, NONE);
+	for(NodeId i = 0; i <= root; i++)
+	{
+		if(!need[i])
+			continue;
+
+		Node n = _nodes[i];
+		bool p = need[i] & P_POS, q = need[i] & P_NEG;
+
+		switch(n.type)
+		{
+			case T_TRUE:
+			case T_FALSE:
+			case T_ATOM:
+				pos[i] = i;
+				if(q)
+					neg[i] = makeNot(i);
+				break;
+			case T_NOT:
+				pos[i] = p ? neg[n.op1] : NONE;
+				neg[i] = q ? pos[n.op1] : NONE;
+				break;
+			case T_AND:
+				if(p)
+					pos[i] = makeAnd(pos[n.op1], pos[n.op2]);
+				if(q)
+					neg[i] = makeOr(neg[n.op1], neg[n.op2]);
+				break;
+			case T_OR:
+				if(p)
+					pos[i] = makeOr(pos[n.op1], pos[n.op2]);
+				if(q)
+					neg[i] = makeAnd(neg[n.op1], neg[n.op2]);
+				break;
+			case T_IMP:
+				if(p)
+					pos[i] = makeOr(neg[n.op1], pos[n.op2]);
+				if(q)
+					neg[i] = makeAnd(pos[n.op1], neg[n.op2]);
+				break;
+			case T_IFF:
+				if(expandIff)
+				{
+					if(p)
+						pos[i] = makeAnd(makeOr(neg[n.op1], pos[n.op2]), makeOr(neg[n.op2], pos[n.op1]));
+					if(q)
+						neg[i] = makeOr(makeAnd(pos[n.op1], neg[n.op2]), makeAnd(pos[n.op2], neg[n.op1]));
+				}
+				else
+				{
+					if(p)
+						pos[i] = makeIff(pos[n.op1], pos[n.op2]);
+					if(q)
+						neg[i] = makeIff(neg[n.op1], pos[n.op2]);
+				}
+				break;
+		}
+	}
+
+	return pos[root];
+}
+
+// Joins the nodes into a balanced conjunction, so that its depth is
+// logarithmic in their number. An empty list gives TRUE.
+NodeId FormulaPool::makeConjunction(const NodeList &ops)
+{
+	return ops.empty() ? makeTrue() : join(T_AND, ops);
+}
+
+// the same for a disjunction, an empty list gives FALSE
+NodeId FormulaPool::makeDisjunction(const NodeList &ops)
+{
+	return ops.empty() ? makeFalse() : join(T_OR, ops);
+}
+
+NodeId FormulaPool::join(Type t, const NodeList &ops)
+{
+	NodeList level(ops);
+	while(level.size() > 1)
+	{
+		size_t k = 0;
+		for(size_t i = 0; i + 1 < level.size(); i += 2)
+			level[k++] = make(t, level[i], level[i + 1]);
+		if(level.size() % 2)
+			level[k++] = level.back();
+		level.resize(k);
+	}
+
+	return level[0];
+}
+
+// Chains of And or Or nodes are defined as one n-ary connective, and a
+// conjunction or disjunction at the top is not defined at all: its operands
+// are conjuncts of the result or it is one of them itself.
+NodeId FormulaPool::tseitinTransformation(NodeId root, TseitinMode mode)
+{
+	NodeId f = pushNegation(simplify(root));
+	vector<char> polarity;
+	polarities(f, polarity);
+	joinChains(f, polarity);
+
+	// hash-consing makes equal subformulas one node, so each is defined once
+	NodeList lit(f + 1, NONE);
+	NodeList defs(1, NONE);
+	NodeList ops;
+
+	for(NodeId i = 0; i <= f; i++)
+	{
+		if(!polarity[i] || (polarity[i] & P_JOINED))
+			continue;
+
+		if(isNATF(i))
+		{
+			lit[i] = i;
+			continue;
+		}
+
+		Node n = _nodes[i];
+		NodeId conn;
+
+		if(n.type == T_AND || n.type == T_OR)
+		{
+			chainOperands(i, polarity, ops);
+			for(NodeId &op : ops)
+				op = lit[op];
+
+			if(polarity[i] & P_TOP)
+			{
+				lit[i] = join(T_OR, ops);
+				continue;
+			}
+			if(i == f && n.type == T_AND)
+			{
+				defs.insert(defs.end(), ops.begin(), ops.end());
+				defs[0] = makeTrue();
+				continue;
+			}
+
+			conn = join(n.type, ops);
+			if(i == f)
+			{
+				defs[0] = conn;
+				continue;
+			}
+		}
+		else
+			conn = make(n.type, lit[n.op1], lit[n.op2]);
+
+		NodeId atom = freshAtom();
+		NodeId def;
+
+		if(mode == TM_FULL || polarity[i] == (P_POS | P_NEG))
+			def = makeIff(atom, conn);
+		else if(polarity[i] == P_POS)
+			def = makeImp(atom, conn);
+		else
+			def = makeImp(conn, atom);
+
+		defs.push_back(def);
+		lit[i] = atom;
+	}
+
+	if(defs[0] == NONE)
+		defs[0] = lit[f];
+	if(_nodes[defs[0]].type == T_TRUE)
+		defs.erase(defs.begin());
+
+	return makeConjunction(defs);
+}
+
+// Emits the clauses of the Tseitin transformation of root directly, without
+// building the definitions and their nnf as formulas first. The atoms of
+// root get the first variables and the fresh atoms the ones after them, in
+// node order; the first fresh variable is returned. If workers are given,
+// large formulas are split into ranges of nodes that are named and encoded
+// in parallel; the result is the same as without them. It must not be called
+// from a job of the same workers.
+unsigned FormulaPool::tseitinCNF(NodeId root, Cnf &cnf, TseitinMode mode, ThreadPool *workers)
+{
+	NodeId f = pushNegation(simplify(root));
+
+	if(_nodes[f].type == T_TRUE)
+		return cnf.numVariables() + 1;
+	if(_nodes[f].type == T_FALSE)
+	{
+		cnf.endClause();
+		return cnf.numVariables() + 1;
+	}
+
+	vector<char> polarity;
+	polarities(f, polarity);
+	joinChains(f, polarity);
+
+	size_t jobs = workers == nullptr ? 1 : max<size_t>(1, min<size_t>(4 * workers->numThreads(), (f + 1) / TSEITIN_JOB_NODES));
+	NodeList bounds(jobs + 1);
+	for(size_t k = 0; k <= jobs; k++)
+		bounds[k] = (uint64_t) (f + 1) * k / jobs;
+
+	// numbers the atoms and counts the connectives before each range
+	vector<Cnf::Literal> lit(f + 1, 0);
+	vector<unsigned> fresh(jobs + 1, 0);
+
+	for(size_t k = 0; k < jobs; k++)
+	{
+		fresh[k + 1] = fresh[k];
+
+		for(NodeId i = bounds[k]; i < bounds[k + 1]; i++)
+		{
+			if(!polarity[i])
+				continue;
+
+			const Node &n = _nodes[i];
+			if(n.type == T_ATOM)
+				lit[i] = cnf.getVariable(_names[n.op1]);
+			else if(n.type == T_NOT)
+			{
+				assert(_nodes[n.op1].type == T_ATOM && "negation was not pushed to an atom");
+				lit[i] = -(Cnf::Literal) cnf.getVariable(_names[_nodes[n.op1].op1]);
+			}
+			else if(!(polarity[i] & (P_JOINED | P_TOP)) && !(i == f && (n.type == T_AND || n.type == T_OR)))
+				fresh[k + 1]++;
+		}
+	}
+
+	// each range gets its own block of fresh variables and names
+	unsigned firstVar = cnf.addVariables(fresh[jobs]);
+	unsigned firstName = reserveFresh(fresh[jobs]);
+
+	auto variables = [&](size_t k)
+	{
+		unsigned next = fresh[k];
+
+		for(NodeId i = bounds[k]; i < bounds[k + 1]; i++)
+		{
+			if(!polarity[i] || isNATF(i) || (polarity[i] & (P_JOINED | P_TOP)))
+				continue;
+			if(i == f && (_nodes[i].type == T_AND || _nodes[i].type == T_OR))
+				continue;
+
+			lit[i] = firstVar + next;
+			cnf.setName(lit[i], _context->getName(firstName + next));
+			next++;
+		}
+	};
+
+	if(jobs == 1)
+	{
+		variables(0);
+		tseitinClauses(0, f + 1, polarity, lit, mode, cnf);
+	}
+	else
+	{
+		// each range gets its own clause buffer, the buffers are joined in
+		// node order so the result does not depend on the threads
+		vector<Cnf> parts(jobs);
+
+		workers->run(jobs, variables);
+		workers->run(jobs, [&](size_t k)
+		{
+			tseitinClauses(bounds[k], bounds[k + 1], polarity, lit, mode, parts[k]);
+		});
+
+		for(size_t k = 0; k < jobs; k++)
+		{
+			cnf.append(parts[k]);
+			parts[k].clear();
+		}
+	}
+
+	// a conjunction at the top gives a clause per operand and a disjunction
+	// one clause, otherwise the root is a unit clause
+	if(_nodes[f].type == T_AND || _nodes[f].type == T_OR)
+	{
+		NodeList ops, clause;
+		chainOperands(f, polarity, ops);
+
+		for(NodeId op : ops)
+		{
+			if(polarity[op] & P_TOP)
+			{
+				chainOperands(op, polarity, clause);
+				for(NodeId l : clause)
+					cnf.addLiteral(lit[l]);
+			}
+			else
+				cnf.addLiteral(lit[op]);
+
+			if(_nodes[f].type == T_AND)
+				cnf.endClause();
+		}
+		if(_nodes[f].type == T_OR)
+			cnf.endClause();
+	}
+	else
+	{
+		cnf.addLiteral(lit[f]);
+		cnf.endClause();
+	}
+
+	return firstVar;
+}
+
+// Emits the definitions of the connectives among the nodes [first, last)
+// whose variables are given in lit; connectives without a variable are
+// defined as part of another one or at the top. A chain of And or Or nodes
+// with n operands gets n binary clauses and one of n + 1 literals.
+void FormulaPool::tseitinClauses(NodeId first, NodeId last, const vector<char> &polarity, const vector<Cnf::Literal> &lit, TseitinMode mode, Cnf &cnf) const
+{
+	NodeList ops;
+
+	for(NodeId i = first; i < last; i++)
+	{
+		const Node &n = _nodes[i];
+		if(!polarity[i] || isNATF(i) || lit[i] == 0)
+			continue;
+
+		Cnf::Literal s = lit[i], a = lit[n.op1], b = lit[n.op2];
+		bool pos = mode == TM_FULL || (polarity[i] & P_POS);
+		bool neg = mode == TM_FULL || (polarity[i] & P_NEG);
+
+		if(n.type == T_AND || n.type == T_OR)
+			chainOperands(i, polarity, ops);
+
+		// clauses of s => conn if pos and of conn => s if neg
+		switch(n.type)
+		{
+			case T_AND:
+				if(pos)
+					for(NodeId op : ops)
+						addClause(cnf, {-s, lit[op]});
+				if(neg)
+				{
+					for(NodeId op : ops)
+						cnf.addLiteral(-lit[op]);
+					cnf.addLiteral(s);
+					cnf.endClause();
+				}
+				break;
+			case T_OR:
+				if(pos)
+				{
+					cnf.addLiteral(-s);
+					for(NodeId op : ops)
+						cnf.addLiteral(lit[op]);
+					cnf.endClause();
+				}
+				if(neg)
+					for(NodeId op : ops)
+						addClause(cnf, {-lit[op], s});
+				break;
+			case T_IMP:
+				if(pos)
+					addClause(cnf, {-s, -a, b});
+				if(neg)
+				{
+					addClause(cnf, {a, s});
+					addClause(cnf, {-b, s});
+				}
+				break;
+			case T_IFF:
+				if(pos)
+				{
+					addClause(cnf, {-s, -a, b});
+					addClause(cnf, {-s, a, -b});
+				}
+				if(neg)
+				{
+					addClause(cnf, {a, b, s});
+					addClause(cnf, {-a, -b, s});
+				}
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+// Computes the polarities in which the connectives above the literals of
+// root occur (operands of an equivalence occur in both). Nodes that are not
+// reached this way are left 0.
+void FormulaPool::polarities(NodeId root, vector<char> &polarity) const
+{
+	polarity.assign(root + 1, 0);
+	polarity[root] = P_POS;
+
+	for(NodeId i = root + 1; i-- > 0; )
+	{
+		if(!polarity[i] || isNATF(i))
+			continue;
+
+		char p = polarity[i];
+		char flipped = (p & P_POS ? P_NEG : 0) | (p & P_NEG ? P_POS : 0);
+		const Node &n = _nodes[i];
+
+		switch(n.type)
+		{
+			case T_IFF:
+				polarity[n.op1] |= P_POS | P_NEG;
+				polarity[n.op2] |= P_POS | P_NEG;
+				break;
+			case T_IMP:
+				polarity[n.op1] |= flipped;
+				polarity[n.op2] |= p;
+				break;
+			default:
+				polarity[n.op1] |= p;
+				polarity[n.op2] |= p;
+				break;
+		}
+	}
+}
+
+// Marks with P_JOINED the And and Or nodes among those reached from root that
+// are used once, by a node of the same type. A node that is not marked and
+// the marked ones below it form one n-ary connective. If root is an And, its
+// operands that are Or nodes used only by it are marked with P_TOP.
+void FormulaPool::joinChains(NodeId root, vector<char> &polarity) const
+{
+	vector<char> uses(root + 1, 0);
+
+	for(NodeId i = 0; i <= root; i++)
+	{
+		if(!polarity[i] || isNATF(i))
+			continue;
+
+		const Node &n = _nodes[i];
+		uses[n.op1] = min(uses[n.op1] + 1, 2);
+		uses[n.op2] = min(uses[n.op2] + 1, 2);
+	}
+
+	for(NodeId i = 0; i <= root; i++)
+	{
+		if(!polarity[i] || isNATF(i))
+			continue;
+
+		const Node &n = _nodes[i];
+		if(n.type != T_AND && n.type != T_OR)
+			continue;
+
+		if(uses[n.op1] == 1 && _nodes[n.op1].type == n.type)
+			polarity[n.op1] |= P_JOINED;
+		if(uses[n.op2] == 1 && _nodes[n.op2].type == n.type)
+			polarity[n.op2] |= P_JOINED;
+	}
+
+	if(_nodes[root].type == T_AND)
+	{
+		NodeList ops;
+		chainOperands(root, polarity, ops);
+
+		for(NodeId op : ops)
+			if(uses[op] == 1 && _nodes[op].type == T_OR)
+				polarity[op] |= P_TOP;
+	}
+}
+
+// sets ops to the operands of the n-ary connective of node n, left to right
+void FormulaPool::chainOperands(NodeId n, const vector<char> &polarity, NodeList &ops) const
+{
+	NodeList stack(1, n);
+
+	ops.clear();
+	while(!stack.empty())
+	{
+		NodeId i = stack.back();
+		stack.pop_back();
+
+		if(i != n && !(polarity[i] & P_JOINED))
+		{
+			ops.push_back(i);
+			continue;
+		}
+
+		stack.push_back(_nodes[i].op2);
+		stack.push_back(_nodes[i].op1);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Flat CNF
+//-----------------------------------------------------------------------------
+// Converts root to nnf and distributes Or over And. An operand of an Or whose
+// product would take more than budget literals is replaced with a fresh atom s,
+// defined after the clauses of the root by adding -s to each clause of the
+// operand. In nnf every node is used positively, so s -> operand is enough.
+void FormulaPool::flatCNF(NodeId root, Cnf &cnf, size_t budget)
+{
+	root = nnf(root);
+
+	vector<char> named;
+	unsigned count = nameOperands(root, budget, named);
+	unsigned firstName = count > 0 ? reserveFresh(count) : 0;
+	vector<Cnf::Literal> literals(root + 1, 0);
+
+	// the nodes on the path to the current one, how many of their operands
+	// were done and the clause count before each of them
+	struct Frame
+	{
+		NodeId n;
+		int done;
+		size_t marks[2];
+	};
+
+	vector<Frame> stack;
+	// the root and then the named nodes in the order their atoms were made
+	NodeList defined(1, root);
+
+	for(size_t k = 0; k < defined.size(); k++)
+	{
+		NodeId def = defined[k];
+		size_t first = cnf.numClauses();
+
+		stack.push_back(Frame{def, 0, {0, 0}});
+		while(!stack.empty())
+		{
+			Frame &top = stack.back();
+			const Node &node = _nodes[top.n];
+
+			if(named[top.n] && top.n != def)
+			{
+				if(literals[top.n] == 0)
+				{
+					literals[top.n] = cnf.getVariable(_context->getName(firstName + defined.size() - 1));
+					defined.push_back(top.n);
+				}
+				cnf.addLiteral(literals[top.n]);
+				cnf.endClause();
+				stack.pop_back();
+				continue;
+			}
+
+			if((node.type == T_AND || node.type == T_OR) && top.done < 2)
+			{
+				NodeId next = top.done == 0 ? node.op1 : node.op2;
+				top.marks[top.done++] = cnf.numClauses();
+				stack.push_back(Frame{next, 0, {0, 0}});
+				continue;
+			}
+
+			switch(node.type)
+			{
+				case T_TRUE:
+				case T_AND:
+					break;
+				case T_FALSE:
+					cnf.endClause();
+					break;
+				case T_ATOM:
+					cnf.addLiteral(literal(top.n, cnf, literals));
+					cnf.endClause();
+					break;
+				case T_NOT:
+					// a negated constant is the other constant
+					if(_nodes[node.op1].type != T_FALSE)
+					{
+						if(_nodes[node.op1].type == T_ATOM)
+							cnf.addLiteral(literal(top.n, cnf, literals));
+						cnf.endClause();
+					}
+					break;
+				case T_OR:
+					cnf.makePairs(top.marks[0], top.marks[1]);
+					break;
+				default:
+					assert(!"nnf left an implication or equivalence");
+			}
+
+			stack.pop_back();
+		}
+
+		if(k > 0)
+			cnf.addToClauses(first, -literals[def]);
+	}
+}
+
+// Estimates the clauses and literals flatCNF makes for each node under root
+// and marks in named the Or operands that are to get a fresh atom so that no
+// product takes more than budget literals. Returns the number of marks.
+unsigned FormulaPool::nameOperands(NodeId root, size_t budget, vector<char> &named) const
+{
+	vector<size_t> clauses(root + 1, 0), literals(root + 1, 0);
+	vector<char> reached(root + 1, 0);
+	unsigned count = 0;
+
+	named.assign(root + 1, 0);
+	reached[root] = 1;
+	for(NodeId i = root + 1; i-- > 0; )
+		if(reached[i] && (_nodes[i].type == T_AND || _nodes[i].type == T_OR))
+			reached[_nodes[i].op1] = reached[_nodes[i].op2] = 1;
+
+	for(NodeId i = 0; i <= root; i++)
+	{
+		if(!reached[i])
+			continue;
+
+		const Node &node = _nodes[i];
+		NodeId op[2] = {node.op1, node.op2};
+
+		switch(node.type)
+		{
+			case T_TRUE:
+				break;
+			case T_FALSE:
+				clauses[i] = 1;
+				break;
+			case T_AND:
+				clauses[i] = addBounded(clauses[op[0]], clauses[op[1]]);
+				literals[i] = addBounded(literals[op[0]], literals[op[1]]);
+				break;
+			case T_OR:
+				while(true)
+				{
+					literals[i] = addBounded(mulBounded(clauses[op[0]], literals[op[1]]), mulBounded(clauses[op[1]], literals[op[0]]));
+
+					// the larger operand that is not a literal yet
+					NodeId next = NONE;
+					for(NodeId o : op)
+						if(literals[o] > 1 && (next == NONE || literals[o] > literals[next]))
+							next = o;
+					if(literals[i] <= budget || next == NONE)
+						break;
+
+					named[next] = 1;
+					clauses[next] = literals[next] = 1;
+					count++;
+				}
+				clauses[i] = mulBounded(clauses[op[0]], clauses[op[1]]);
+				break;
+			case T_NOT:
+				clauses[i] = _nodes[node.op1].type != T_FALSE;
+				literals[i] = _nodes[node.op1].type == T_ATOM;
+				break;
+			default:
+				clauses[i] = literals[i] = 1;
+		}
+	}
+
+	return count;
+}
+
+// maps an atom or a negated atom to its literal in cnf
+Cnf::Literal FormulaPool::literal(NodeId n, Cnf &cnf, vector<Cnf::Literal> &literals) const
+{
+	if(literals[n] == 0)
+	{
+		const Node &node = _nodes[n];
+
+		if(node.type == T_NOT)
+			literals[n] = -literal(node.op1, cnf, literals);
+		else
+			literals[n] = cnf.getVariable(_names[node.op1]);
+	}
+
+	return literals[n];
+}
+
+//-----------------------------------------------------------------------------
+// Printing
+//-----------------------------------------------------------------------------
+void FormulaPool::print(ostream &ostr, NodeId n) const
+{
+	OutputBuffer text;
+
+	FormulaWriter(text).write(*this, n);
+	ostr << text.str();
+}
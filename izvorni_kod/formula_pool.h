@@ -0,0 +1,94 @@
+#ifndef _FORMULA_POOL_H_
+#define _FORMULA_POOL_H_
+
+#include "prop_logic.h"
+#include "tseitin_context.h"
+#include <cstdint>
+
+// handle of a node stored in a FormulaPool
+typedef uint32_t NodeId;
+typedef std::vector<NodeId> NodeList;
+
+class ThreadPool;
+
+// Arena of hash-consed formula nodes. Nodes are stored contiguously and refer
+// to their operands by 32-bit index. An operand is always created before the
+// node using it, so every pass is a loop over the index range instead of a
+// recursion, and the whole pool is released at once when it is destroyed.
+class FormulaPool
+{
+public:
+	static const NodeId NONE = UINT32_MAX;
+	// smallest number of nodes worth a job of their own in tseitinCNF
+	static const NodeId TSEITIN_JOB_NODES = 1 << 16;
+	// most literals flatCNF lets one distribution of Or over And make
+	static const size_t FLAT_CNF_BUDGET = 1 << 12;
+
+	FormulaPool(TseitinContext *context = nullptr);
+
+	NodeId makeTrue() const;
+	NodeId makeFalse() const;
+	NodeId makeAtom(const std::string &id);
+	NodeId makeNot(NodeId op);
+	NodeId makeAnd(NodeId op1, NodeId op2);
+	NodeId makeOr(NodeId op1, NodeId op2);
+	NodeId makeImp(NodeId op1, NodeId op2);
+	NodeId makeIff(NodeId op1, NodeId op2);
+	NodeId make(Type t, NodeId op1, NodeId op2);
+	NodeId makeConjunction(const NodeList &ops);
+	NodeId makeDisjunction(const NodeList &ops);
+
+	Type getType(NodeId n) const;
+	NodeId getOp(NodeId n) const;
+	NodeId getOp1(NodeId n) const;
+	NodeId getOp2(NodeId n) const;
+	const std::string& getId(NodeId n) const;
+	bool isNATF(NodeId n) const;
+	size_t size() const;
+
+	NodeId import(const Formula &f);
+	Formula toFormula(NodeId root) const;
+
+	NodeId simplify(NodeId root);
+	NodeId pushNegation(NodeId root);
+	NodeId nnf(NodeId root);
+	NodeId tseitinTransformation(NodeId root, TseitinMode mode = TM_FULL);
+	unsigned tseitinCNF(NodeId root, Cnf &cnf, TseitinMode mode = TM_FULL, ThreadPool *workers = nullptr);
+	void flatCNF(NodeId root, Cnf &cnf, size_t budget = FLAT_CNF_BUDGET);
+	void print(std::ostream &ostr, NodeId n) const;
+
+	void clear();
+
+private:
+	// reads the nodes directly when printing
+	friend class FormulaWriter;
+
+	// atoms keep the index of their name in _names as op1
+	struct Node
+	{
+		Type type;
+		NodeId op1, op2;
+	};
+
+	std::vector<Node> _nodes;
+	std::vector<std::string> _names;
+	std::unordered_map<std::string, NodeId> _atoms;
+	NodeList _table;
+	TseitinContext _ownContext;
+	TseitinContext *_context;
+
+	void rehash();
+	NodeId freshAtom();
+	unsigned reserveFresh(unsigned n);
+	NodeId rewriteNegations(NodeId root, bool expandIff);
+	NodeId join(Type t, const NodeList &ops);
+	void polarities(NodeId root, std::vector<char> &polarity) const;
+	void joinChains(NodeId root, std::vector<char> &polarity) const;
+	void chainOperands(NodeId n, const std::vector<char> &polarity, NodeList &ops) const;
+	void tseitinClauses(NodeId first, NodeId last, const std::vector<char> &polarity, const std::vector<Cnf::Literal> &lit, TseitinMode mode, Cnf &cnf) const;
+	unsigned nameOperands(NodeId root, size_t budget, std::vector<char> &named) const;
+	Cnf::Literal literal(NodeId n, Cnf &cnf, std::vector<Cnf::Literal> &literals) const;
+};
+
+
+#endif //_FORMULA_POOL_H_
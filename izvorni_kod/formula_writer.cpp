@@ -0,0 +1,115 @@
+#include "formula_writer.h"
+#include "colors.h"
+
+using namespace std;
+
+static inline bool isNATF(Type t)
+{
+	return t == T_TRUE || t == T_FALSE || t == T_ATOM || t == T_NOT;
+}
+
+FormulaWriter::FormulaWriter(OutputBuffer &out, bool ascii, bool color)
+	: _out(out), _not(ascii ? "~" : "¬"), _false(ascii ? "F" : "FALSE"), _color(color)
+{}
+
+// Writes n without recursion: an entry of the stack is either a node or, if
+// the node is NONE, a piece of text that follows its operands.
+void FormulaWriter::write(const FormulaPool &pool, NodeId n)
+{
+	const NodeId NONE = FormulaPool::NONE;
+
+	_stack.assign(1, make_pair(n, (const char*) nullptr));
+	while(!_stack.empty())
+	{
+		pair<NodeId, const char*> item = _stack.back();
+		_stack.pop_back();
+
+		if(item.first == NONE)
+		{
+			write(item.second);
+			continue;
+		}
+
+		const FormulaPool::Node &node = pool._nodes[item.first];
+		const char *conn;
+
+		switch(node.type)
+		{
+			case T_TRUE:
+				_out.putString("TRUE", 4);
+				continue;
+			case T_FALSE:
+				_out.putString(_false);
+				continue;
+			case T_ATOM:
+				_out.putString(pool._names[node.op1]);
+				continue;
+			case T_NOT:
+				_out.putString(_not);
+				if(!isNATF(pool._nodes[node.op1].type))
+				{
+					_out.putString("(", 1);
+					_stack.push_back(make_pair(NONE, ")"));
+				}
+				_stack.push_back(make_pair(node.op1, (const char*) nullptr));
+				continue;
+			case T_AND:
+				conn = " /\\ ";
+				break;
+			case T_OR:
+				conn = " \\/ ";
+				break;
+			case T_IMP:
+				conn = " => ";
+				break;
+			default:
+				conn = " <=> ";
+				break;
+		}
+
+		NodeId op1 = node.op1, op2 = node.op2;
+		// as in the parser, connectives group from the left
+		bool paren1 = !(pool._nodes[op1].type == node.type || isNATF(pool._nodes[op1].type));
+		bool paren2 = !isNATF(pool._nodes[op2].type);
+
+		if(paren2)
+			_stack.push_back(make_pair(NONE, ")"));
+		_stack.push_back(make_pair(op2, (const char*) nullptr));
+		if(paren2)
+			_stack.push_back(make_pair(NONE, "("));
+		_stack.push_back(make_pair(NONE, conn));
+		if(paren1)
+			_stack.push_back(make_pair(NONE, ")"));
+		_stack.push_back(make_pair(op1, (const char*) nullptr));
+
+		if(paren1)
+			_out.putString("(", 1);
+	}
+}
+
+void FormulaWriter::write(const Cnf &cnf)
+{
+	_out.putString("[ ", 2);
+	for(size_t i = 0; i < cnf.numClauses(); i++)
+	{
+		_out.putString("[ ", 2);
+		for(const Cnf::Literal *l = cnf.clauseBegin(i); l != cnf.clauseEnd(i); l++)
+		{
+			if(*l < 0)
+				_out.putString(_not);
+			_out.putString(cnf.getName(*l < 0 ? -*l : *l));
+			_out.putString(" ", 1);
+		}
+		_out.putString("] ", 2);
+	}
+	_out.putString(" ]", 2);
+}
+
+void FormulaWriter::heading(const char *text, const char *color)
+{
+	if(_color)
+		write(color);
+	write(text);
+	if(_color)
+		write(RST);
+}
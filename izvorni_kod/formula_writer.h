@@ -0,0 +1,35 @@
+#ifndef _FORMULA_WRITER_H_
+#define _FORMULA_WRITER_H_
+
+#include "formula_pool.h"
+#include "output_buffer.h"
+#include <cstring>
+
+// Formats formulas of a pool and clause sets straight into an OutputBuffer,
+// in the notation of FormulaPool::print and Cnf::print. In ascii mode
+// negation is ~ and false is F, as in the input, so the text can be read
+// back. With color set, headings are wrapped in the ANSI codes of colors.h.
+class FormulaWriter
+{
+public:
+	FormulaWriter(OutputBuffer &out, bool ascii = false, bool color = false);
+
+	void write(const FormulaPool &pool, NodeId n);
+	void write(const Cnf &cnf);
+	void heading(const char *text, const char *color);
+
+	void write(const char *text)
+	{
+		_out.putString(text, strlen(text));
+	}
+
+private:
+	OutputBuffer &_out;
+	std::string _not, _false;
+	bool _color;
+	// pending output: a node or, if the node is NONE, a text
+	std::vector<std::pair<NodeId, const char*>> _stack;
+};
+
+
+#endif //_FORMULA_WRITER_H_
@@ -1,29 +1,628 @@
 #include "prop_logic.h"
+#include "formula_pool.h"
+#include "dimacs.h"
+#include "formula_writer.h"
+#include "cnf_simplifier.h"
+#include "thread_pool.h"
+#include "stats.h"
 #include "colors.h"
+#include "output_buffer.h"
+#include "binary_format.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <fstream>
+#include <deque>
 
 using namespace std;
 
 extern int yyparse();
 extern Formula parsed_formula;
+extern const char *parse_error;
+extern void (*formula_handler)(const Formula&);
+extern void setInput(const char *begin, size_t size);
+extern void setInput(int fd);
 
-int main()
+// more threads than this are not started, whatever -j asks for
+static const long MAX_THREADS = 1024;
+
+// what was asked for on the command line
+struct Options
+{
+	const char *dimacs = nullptr;
+	const char *binary = nullptr;
+	bool names = false;
+	bool simplify = false;
+	bool eliminate = false;
+	TseitinMode mode = TM_FULL;
+	bool batch = false;
+	unsigned threads = 0;
+	std::string prefix = "s";
+	const char *stats = nullptr;
+	bool ascii = false;
+	// colors are used only on a terminal
+	bool color = false;
+};
+
+// a formula of the input: parsed from text or a record of a binary file
+struct Input
+{
+	Formula formula;
+	BinaryRecord record;
+};
+
+// output for one formula: the clauses if DIMACS output was asked for,
+// the printed stages of the transformation otherwise, and the binary form
+// if it was asked for; a single formula is written straight to the output
+// instead
+struct Result
+{
+	Cnf cnf;
+	string text;
+	string binary;
+	// the binary record it came from could not be read
+	bool damaged = false;
+};
+
+static Options options;
+static DimacsWriter *writer = nullptr;
+static OutputBuffer *textOutput = nullptr;
+static OutputBuffer *binaryOutput = nullptr;
+static bool writeFailed = false;
+static bool damagedInput = false;
+// formulas handed over by the parser and whether it stopped at an error
+static size_t numParsed = 0;
+static bool parseFailed = false;
+
+// batch mode: the workers and the results that were not written yet, in input order
+static ThreadPool *workers = nullptr;
+static deque<future<Result>> pending;
+static size_t maxPending;
+
+static void usage(const char *program)
+{
+	cerr << "usage: " << program << " [-d file] [-o file] [-c] [-r] [-e] [-p] [-b] [-j threads] [-s name] [-t file] [-a] [input]" << endl
+		<< "  input    file to read the formulas from (default: standard input); a file" << endl
+		<< "           written with -o is recognized and read without parsing" << endl
+		<< "  -d file  write the clauses in DIMACS format to file (- for standard output)" << endl
+		<< "  -o file  write the result in binary form to file (- for standard output):" << endl
+		<< "           the clauses with -d, the formula after the transformation" << endl
+		<< "           instead of the printed stages otherwise" << endl
+		<< "  -c       add the names of the atoms to the DIMACS output as comments" << endl
+		<< "  -r       remove duplicate literals, tautologies and subsumed clauses and" << endl
+		<< "           strengthen clauses before the DIMACS output" << endl
+		<< "  -e       like -r, and also eliminate fresh atoms where that does not add" << endl
+		<< "           clauses" << endl
+		<< "  -p       define fresh atoms only in the direction their polarity needs" << endl
+		<< "           (Plaisted-Greenbaum) instead of with full equivalences" << endl
+		<< "  -b       transform every formula of the input, not only the first one;" << endl
+		<< "           the results are written in input order; with -d the file is a" << endl
+		<< "           stream of DIMACS instances, one per formula, each with its own" << endl
+		<< "           header and variables numbered from 1, after a line c formula n" << endl
+		<< "  -j n     use n threads, at most 1024 (default: one per core)" << endl
+		<< "  -s name  prefix of the names of fresh atoms (default: s)" << endl
+		<< "  -t file  write statistics of the stages as JSON to file (- for standard" << endl
+		<< "           error), needs a program built with make STATS=1" << endl
+		<< "  -a       plain ASCII text output: ~ for negation and F for false, as in" << endl
+		<< "           the input, and no colors" << endl;
+}
+
+// the atoms of the formula, the variables before fresh, keep their values
+// in models
+static void simplify(Cnf &cnf, unsigned fresh)
+{
+	{
+		STATS_TIMER(timer, ST_SIMPLIFY);
+		CnfSimplifier simplifier(cnf);
+		for(unsigned var = 1; var < fresh; var++)
+			simplifier.freeze(var);
+		simplifier.run(options.eliminate);
+	}
+	STATS_RUN(ST_SIMPLIFY);
+	STATS_COUNT_CNF(ST_SIMPLIFY, cnf);
+}
+
+// clauses read from a binary file need no transformation, they are only
+// simplified and written again or printed
+static Result transformClauses(const BinaryRecord &record, OutputBuffer &text, OutputBuffer *binary)
+{
+	Result res;
+
+	{
+		STATS_TIMER(timer, ST_IMPORT);
+		res.damaged = !record.load(res.cnf);
+	}
+	STATS_RUN(ST_IMPORT);
+	if(res.damaged)
+		return res;
+	STATS_COUNT_CNF(ST_IMPORT, res.cnf);
+
+	if(options.dimacs == nullptr && binary == nullptr)
+	{
+		STATS_TIMER(timer, ST_OUTPUT);
+		FormulaWriter out(text, options.ascii, options.color);
+
+		out.heading("Flat formula format: ", KCYN);
+		out.write(res.cnf);
+		out.write("\n");
+		return res;
+	}
+
+	if(options.simplify)
+		simplify(res.cnf, record.getFresh());
+
+	if(binary != nullptr)
+	{
+		STATS_TIMER(timer, ST_OUTPUT);
+		TseitinContext context(record.getPrefix());
+
+		BinaryWriter(*binary).write(res.cnf, record.getFresh(), context);
+	}
+
+	return res;
+}
+
+// without DIMACS or binary output the stages are printed to text; workers,
+// if given, are used to encode the formula in parallel
+static Result transform(const Input &in, OutputBuffer &text, OutputBuffer *binary, ThreadPool *workers = nullptr)
+{
+	if(in.formula.get() == nullptr && in.record.getKind() == BinaryRecord::BR_CNF)
+		return transformClauses(in.record, text, binary);
+
+	// the pipeline runs on a pool, the parsed tree is no longer needed
+	TseitinContext context(options.prefix);
+	FormulaPool pool(&context);
+	NodeId a;
+	Result res;
+
+	{
+		STATS_TIMER(timer, ST_IMPORT);
+		if(in.formula.get() != nullptr)
+			a = pool.import(in.formula);
+		else
+		{
+			// fresh atoms continue the numbering of those already in the record
+			if(in.record.getPrefix() == options.prefix)
+				context.reserve(in.record.getFresh());
+			res.damaged = !in.record.load(pool, a);
+		}
+	}
+	STATS_RUN(ST_IMPORT);
+	if(res.damaged)
+		return res;
+	STATS_COUNT(ST_IMPORT, SC_NODES, pool.size());
+
+	if(options.dimacs != nullptr)
+	{
+		// the clauses are emitted directly, without the intermediate formulas
+		unsigned fresh;
+		{
+			STATS_TIMER(timer, ST_TSEITIN);
+			fresh = pool.tseitinCNF(a, res.cnf, options.mode, workers);
+		}
+		STATS_RUN(ST_TSEITIN);
+		STATS_COUNT(ST_TSEITIN, SC_NODES, pool.size());
+		STATS_COUNT(ST_TSEITIN, SC_FRESH, context.numReserved());
+		STATS_COUNT_CNF(ST_TSEITIN, res.cnf);
+
+		if(options.simplify)
+			simplify(res.cnf, fresh);
+
+		if(binary != nullptr)
+		{
+			STATS_TIMER(timer, ST_OUTPUT);
+			BinaryWriter(*binary).write(res.cnf, fresh, context);
+		}
+
+		return res;
+	}
+
+	if(binary != nullptr)
+	{
+		NodeId b;
+		{
+			STATS_TIMER(timer, ST_TSEITIN);
+			b = pool.tseitinTransformation(a, options.mode);
+		}
+		STATS_RUN(ST_TSEITIN);
+		STATS_COUNT(ST_TSEITIN, SC_NODES, pool.size());
+		STATS_COUNT(ST_TSEITIN, SC_FRESH, context.numReserved());
+		{
+			STATS_TIMER(timer, ST_OUTPUT);
+			BinaryWriter(*binary).write(pool, b, context);
+		}
+
+		return res;
+	}
+
+	FormulaWriter out(text, options.ascii, options.color);
+
+	{
+		STATS_TIMER(timer, ST_OUTPUT);
+		out.heading("Formula before transformation: ", KRED);
+		out.write(pool, a);
+		out.write("\n");
+	}
+
+	NodeId b;
+	{
+		STATS_TIMER(timer, ST_TSEITIN);
+		b = pool.tseitinTransformation(a, options.mode);
+	}
+	STATS_RUN(ST_TSEITIN);
+	STATS_COUNT(ST_TSEITIN, SC_NODES, pool.size());
+	STATS_COUNT(ST_TSEITIN, SC_FRESH, context.numReserved());
+	{
+		STATS_TIMER(timer, ST_OUTPUT);
+		out.heading("Formula after transformation: ", KGRN);
+		out.write(pool, b);
+		out.write("\n");
+	}
+
+	NodeId c;
+	{
+		STATS_TIMER(timer, ST_NNF);
+		c = pool.nnf(b);
+	}
+	STATS_RUN(ST_NNF);
+	STATS_COUNT(ST_NNF, SC_NODES, pool.size());
+	{
+		STATS_TIMER(timer, ST_OUTPUT);
+		out.heading("Formula after nnf: ", KYEL);
+		out.write(pool, c);
+		out.write("\n");
+	}
+
+	Cnf d;
+	{
+		STATS_TIMER(timer, ST_FLAT_CNF);
+		pool.flatCNF(c, d);
+	}
+	STATS_RUN(ST_FLAT_CNF);
+	STATS_COUNT(ST_FLAT_CNF, SC_NODES, pool.size());
+	STATS_COUNT(ST_FLAT_CNF, SC_FRESH, context.numReserved());
+	STATS_COUNT_CNF(ST_FLAT_CNF, d);
+	{
+		STATS_TIMER(timer, ST_OUTPUT);
+		out.heading("Flat formula format: ", KCYN);
+		out.write(d);
+		out.write("\n");
+	}
+
+	return res;
+}
+
+// results come in input order; the n-th result of a batch is formula n
+static void output(const Result &res)
+{
+	STATS_TIMER(timer, ST_OUTPUT);
+	static size_t formula = 0;
+
+	STATS_RUN(ST_OUTPUT);
+	formula++;
+	if(res.damaged)
+		damagedInput = true;
+	else if(writer != nullptr)
+	{
+		// each formula is an instance of its own, found by its comment line
+		if(options.batch)
+			writer->comment("formula " + to_string(formula));
+		writeFailed = !writer->write(res.cnf, options.names) || writeFailed;
+		STATS_COUNT_CNF(ST_OUTPUT, res.cnf);
+	}
+	else
+		textOutput->putString(res.text);
+
+	if(binaryOutput != nullptr)
+		binaryOutput->putString(res.binary);
+}
+
+// called for every formula in batch mode
+static void submit(const Input &in)
+{
+	pending.push_back(workers->submit([in]()
+	{
+		OutputBuffer text(-1, 1 << 12), binary(-1, 1 << 12);
+		Result res = transform(in, text, binaryOutput != nullptr ? &binary : nullptr);
+
+		res.text = text.str();
+		res.binary = binary.str();
+		return res;
+	}));
+
+	// results are written as soon as all before them are, so that memory
+	// stays bounded however long the input is
+	while(pending.size() > maxPending || (!pending.empty() && pending.front().wait_for(chrono::seconds(0)) == future_status::ready))
+	{
+		output(pending.front().get());
+		pending.pop_front();
+	}
+}
+
+// called by the parser for every formula in batch mode
+static void submitFormula(const Formula &f)
 {
-	yyparse();
+	Input in;
+
+	in.formula = f;
+	numParsed++;
+	submit(in);
+}
+
+// opens a file to write to, - is standard output
+static int openOutput(const char *name)
+{
+	int fd = strcmp(name, "-") == 0 ? STDOUT_FILENO : open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if(fd < 0)
+		cerr << "cannot open " << name << ": " << strerror(errno) << endl;
+	return fd;
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+
+	while((opt = getopt(argc, argv, "d:o:crepbj:s:t:a")) != -1)
+	{
+		switch(opt)
+		{
+			case 'd':
+				options.dimacs = optarg;
+				break;
+			case 'o':
+				options.binary = optarg;
+				break;
+			case 'c':
+				options.names = true;
+				break;
+			case 'e':
+				options.eliminate = true;
+				// fall through
+			case 'r':
+				options.simplify = true;
+				break;
+			case 'p':
+				options.mode = TM_POLARITY;
+				break;
+			case 'b':
+				options.batch = true;
+				break;
+			case 'j':
+			{
+				char *end;
+				long threads = strtol(optarg, &end, 10);
+
+				if(end == optarg || *end != '\0' || threads < 1)
+				{
+					usage(argv[0]);
+					return 1;
+				}
+				options.threads = threads < MAX_THREADS ? threads : MAX_THREADS;
+				break;
+			}
+			case 's':
+				options.prefix = optarg;
+				break;
+			case 't':
+				options.stats = optarg;
+				break;
+			case 'a':
+				options.ascii = true;
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
 
-	Formula a = parsed_formula;
+	// fresh atoms must be valid identifiers to be read back
+	if(options.prefix.empty() || !isalpha((unsigned char) options.prefix[0]) || options.prefix.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz_0123456789") != string::npos)
+	{
+		usage(argv[0]);
+		return 1;
+	}
 
-	if (a.get() != nullptr)
+	if(options.dimacs != nullptr && options.binary != nullptr && strcmp(options.dimacs, "-") == 0 && strcmp(options.binary, "-") == 0)
 	{
-		cout << FRED("Formula before transformation: ") << a << endl;
+		cerr << "-d and -o cannot both write to standard output" << endl;
+		return 1;
+	}
 
-		Formula b = a->tseitinTransformation();
-		cout << FGRN("Formula after transformation: ") << b << endl;
+#ifndef STATS
+	if(options.stats != nullptr)
+	{
+		cerr << "-t needs a program built with make STATS=1" << endl;
+		return 1;
+	}
+#endif
 
-		Formula c = b->nnf();
-		cout << FYEL("Formula after nnf: ") << c << endl;
+	// a regular file is mapped instead of read
+	int in = optind < argc ? open(argv[optind], O_RDONLY) : STDIN_FILENO;
+	if(in < 0)
+	{
+		cerr << "cannot open " << argv[optind] << ": " << strerror(errno) << endl;
+		return 1;
+	}
+
+	struct stat st;
+	void *input = MAP_FAILED;
+
+	if(fstat(in, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+		input = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, in, 0);
+
+	// only a mapped file is checked for the binary form
+	bool binaryInput = false;
+	if(input != MAP_FAILED)
+	{
+		madvise(input, st.st_size, MADV_SEQUENTIAL);
+		binaryInput = BinaryReader::isBinary((const char*) input, st.st_size);
+		if(!binaryInput)
+			setInput((const char*) input, st.st_size);
+	}
+	else
+		setInput(in);
+
+	int fd = -1;
+	if(options.dimacs != nullptr)
+	{
+		if((fd = openOutput(options.dimacs)) < 0)
+			return 1;
+
+		writer = new DimacsWriter(fd);
+	}
+	else
+		options.color = !options.ascii && isatty(STDOUT_FILENO);
+	textOutput = new OutputBuffer(STDOUT_FILENO);
 
-		LiteralListList d = c->flatCNF();
-		cout << FCYN("Flat formula format: ") << d << endl;
+	int binaryFd = -1;
+	if(options.binary != nullptr)
+	{
+		if((binaryFd = openOutput(options.binary)) < 0)
+			return 1;
+
+		binaryOutput = new OutputBuffer(binaryFd);
+	}
+
+	if(options.batch)
+	{
+		workers = new ThreadPool(options.threads);
+		maxPending = 4 * workers->numThreads();
+
+		// writing the results from submit pauses the input timer
+		{
+			STATS_TIMER(timer, ST_INPUT);
+
+			if(binaryInput)
+			{
+				BinaryReader reader((const char*) input, st.st_size);
+
+				for(Input in; reader.next(in.record); )
+					submit(in);
+				damagedInput = reader.failed();
+			}
+			else
+			{
+				formula_handler = submitFormula;
+				parseFailed = yyparse() != 0;
+			}
+		}
+		STATS_RUN(ST_INPUT);
+
+		for(; !pending.empty(); pending.pop_front())
+			output(pending.front().get());
+
+		delete workers;
+	}
+	else
+	{
+		Input in;
+		bool found;
+
+		{
+			STATS_TIMER(timer, ST_INPUT);
+
+			if(binaryInput)
+			{
+				BinaryReader reader((const char*) input, st.st_size);
+
+				found = reader.next(in.record);
+				damagedInput = reader.failed();
+			}
+			else
+			{
+				parseFailed = yyparse() != 0;
+				in.formula = parsed_formula;
+				parsed_formula = nullptr;
+				found = in.formula.get() != nullptr;
+			}
+		}
+		STATS_RUN(ST_INPUT);
+
+		if(found)
+		{
+			// a single large formula is split among the workers instead
+			if(options.dimacs != nullptr)
+			{
+				ThreadPool encoders(options.threads);
+				output(transform(in, *textOutput, binaryOutput, &encoders));
+			}
+			else
+				output(transform(in, *textOutput, binaryOutput));
+		}
+	}
+
+	if(input != MAP_FAILED)
+		munmap(input, st.st_size);
+	if(in != STDIN_FILENO)
+		close(in);
+
+	{
+		STATS_TIMER(timer, ST_FLUSH);
+
+		STATS_RUN(ST_FLUSH);
+		if(writer != nullptr)
+		{
+			writeFailed = !writer->flush() || writeFailed;
+			delete writer;
+
+			if(fd != STDOUT_FILENO)
+				writeFailed = close(fd) != 0 || writeFailed;
+		}
+
+		if(binaryOutput != nullptr)
+		{
+			writeFailed = !binaryOutput->flush() || writeFailed;
+			delete binaryOutput;
+
+			if(binaryFd != STDOUT_FILENO)
+				writeFailed = close(binaryFd) != 0 || writeFailed;
+		}
+
+		writeFailed = !textOutput->flush() || writeFailed;
+		delete textOutput;
+	}
+
+#ifdef STATS
+	if(options.stats != nullptr)
+	{
+		if(strcmp(options.stats, "-") == 0)
+			Stats::write(cerr);
+		else
+		{
+			ofstream file(options.stats);
+			Stats::write(file);
+			if(!file.flush())
+			{
+				cerr << "cannot write " << options.stats << endl;
+				return 1;
+			}
+		}
+	}
+#endif
+
+	// the results of the formulas before the error are still written
+	if(parseFailed)
+	{
+		cerr << (parse_error != nullptr ? parse_error : "syntax error") << " in formula " << numParsed + 1 << " of "
+			<< (optind < argc ? argv[optind] : "the input") << (options.batch ? ", the formulas after it were not read" : "") << endl;
+		return 1;
+	}
+
+	if(damagedInput)
+	{
+		cerr << "damaged record in " << (optind < argc ? argv[optind] : "the input") << endl;
+		return 1;
+	}
+
+	if(writeFailed)
+	{
+		cerr << "cannot write " << (options.dimacs != nullptr ? options.dimacs : options.binary != nullptr ? options.binary : "the output") << endl;
+		return 1;
 	}
 
 	return 0;
@@ -0,0 +1,125 @@
+#include "output_buffer.h"
+#include <unistd.h>
+#include <cerrno>
+#include <algorithm>
+
+using namespace std;
+
+// "00" "01" ... "99", used to format two digits at a time
+static const char digitPairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+OutputBuffer::OutputBuffer(int fd, size_t bufferSize)
+	: _fd(fd), _buffer(bufferSize < 64 ? 64 : bufferSize), _used(0), _failed(false)
+{}
+
+OutputBuffer::~OutputBuffer()
+{
+	flush();
+}
+
+// writes out what is buffered, returns false if this or an earlier write failed
+bool OutputBuffer::flush()
+{
+	if(_fd < 0)
+		return true;
+
+	const char *p = _buffer.data();
+
+	while(_used > 0 && !_failed)
+	{
+		ssize_t n = ::write(_fd, p, _used);
+
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n <= 0)
+		{
+			_failed = true;
+			break;
+		}
+
+		p += n;
+		_used -= n;
+	}
+
+	_used = 0;
+	return !_failed;
+}
+
+// true once a write to the descriptor has failed
+bool OutputBuffer::failed() const
+{
+	return _failed;
+}
+
+string OutputBuffer::str() const
+{
+	return string(_buffer.data(), _used);
+}
+
+void OutputBuffer::reserve(size_t n)
+{
+	if(_used + n <= _buffer.size())
+		return;
+
+	if(_fd >= 0)
+		flush();
+	else
+		_buffer.resize(max(2 * _buffer.size(), _used + n));
+}
+
+// puts a string that does not fit in the free part of the buffer
+void OutputBuffer::putLongString(const char *s, size_t n)
+{
+	if(_fd < 0)
+		reserve(n);
+
+	while(n > 0)
+	{
+		reserve(1);
+		size_t k = min(n, _buffer.size() - _used);
+
+		memcpy(_buffer.data() + _used, s, k);
+		_used += k;
+		s += k;
+		n -= k;
+	}
+}
+
+void OutputBuffer::putString(const string &s)
+{
+	putString(s.data(), s.size());
+}
+
+// formats the number from the back, two digits per step, and
+// leaves room for a separator after it
+void OutputBuffer::putInt(long long n)
+{
+	char tmp[24];
+	char *end = tmp + sizeof(tmp), *p = end;
+	unsigned long long u = n < 0 ? 0ULL - (unsigned long long) n : n;
+
+	while(u >= 100)
+	{
+		unsigned d = (u % 100) * 2;
+		u /= 100;
+		*--p = digitPairs[d + 1];
+		*--p = digitPairs[d];
+	}
+	if(u >= 10)
+	{
+		*--p = digitPairs[u * 2 + 1];
+		*--p = digitPairs[u * 2];
+	}
+	else
+		*--p = '0' + u;
+
+	if(n < 0)
+		*--p = '-';
+
+	reserve(end - p + 1);
+	memcpy(_buffer.data() + _used, p, end - p);
+	_used += end - p;
+}
@@ -0,0 +1,53 @@
+#ifndef _OUTPUT_BUFFER_H_
+#define _OUTPUT_BUFFER_H_
+
+#include <string>
+#include <vector>
+#include <cstring>
+
+// Output collected in one large buffer and handed to write(2) on a file
+// descriptor when it fills up, so that formatting never goes through ostream
+// and a write moves a whole buffer at once. Without a descriptor the buffer
+// grows instead and the text is taken with str().
+class OutputBuffer
+{
+public:
+	OutputBuffer(int fd = -1, size_t bufferSize = 1 << 20);
+	~OutputBuffer();
+
+	void putString(const std::string &s);
+	void putInt(long long n);
+	bool flush();
+	bool failed() const;
+	std::string str() const;
+	// makes room for n more characters, n must not exceed the size of a
+	// buffer with a descriptor
+	void reserve(size_t n);
+
+	void putChar(char c)
+	{
+		_buffer[_used++] = c;
+	}
+
+	void putString(const char *s, size_t n)
+	{
+		if(_used + n <= _buffer.size())
+		{
+			memcpy(_buffer.data() + _used, s, n);
+			_used += n;
+		}
+		else
+			putLongString(s, n);
+	}
+
+private:
+	int _fd;
+	std::vector<char> _buffer;
+	size_t _used;
+	bool _failed;
+
+	void putLongString(const char *s, size_t n);
+};
+
+
+#endif //_OUTPUT_BUFFER_H_
@@ -1,7 +1,66 @@
 #include "prop_logic.h"
+#include "formula_pool.h"
+#include "bytecode.h"
+#include "bit_evaluator.h"
+#include "sat_solver.h"
+#include "cnf_simplifier.h"
+#include "bdd.h"
+#include <algorithm>
 
 using namespace std;
 
+// flags for the forms of a node that rewriteNegations needs
+enum Polarity { P_POS = 1, P_NEG = 2 };
+
+
+// returns true if t is T_NOT, T_ATOM, T_TRUE or T_FALSE
+static bool isNATF(Type t)
+{
+	return t == T_TRUE || t == T_FALSE || t == T_ATOM || t == T_NOT;
+}
+
+// sets the operands of f, or null where f has none
+static void getOperands(const BaseFormula *f, const BaseFormula *&op1, const BaseFormula *&op2)
+{
+	op1 = op2 = nullptr;
+
+	if(f->getType() == T_NOT)
+		op1 = ((const UnaryConnective*) f)->getOp().get();
+	else if(!isNATF(f->getType()))
+	{
+		op1 = ((const BinaryConnective*) f)->getOp1().get();
+		op2 = ((const BinaryConnective*) f)->getOp2().get();
+	}
+}
+
+// the forms of the operands of a node of type t needed for the given forms of
+// the node, when negations are pushed inwards
+static void operandPolarities(Type t, bool expandIff, int need, int &need1, int &need2)
+{
+	int flipped = (need & P_POS ? P_NEG : 0) | (need & P_NEG ? P_POS : 0);
+
+	need1 = need2 = 0;
+	switch(t)
+	{
+		case T_NOT:
+			need1 = flipped;
+			break;
+		case T_AND:
+		case T_OR:
+			need1 = need2 = need;
+			break;
+		case T_IMP:
+			need1 = flipped;
+			need2 = need;
+			break;
+		case T_IFF:
+			need1 = expandIff ? P_POS | P_NEG : need;
+			need2 = expandIff ? P_POS | P_NEG : P_POS;
+			break;
+		default:
+			break;
+	}
+}
 
 //-----------------------------------------------------------------------------
 // BaseFormula
@@ -10,171 +69,369 @@ using namespace std;
 // returns true if a type of the first arg is T_NOT, T_ATOM, T_TRUE or T_FALSE
 bool BaseFormula::isNATF(const Formula &f) const
 {
-	Type t = f->getType();
-
-	return t == T_TRUE || t == T_FALSE || t == T_ATOM || t == T_NOT;
+	return ::isNATF(f->getType());
 }
 
-bool BaseFormula::isEquivalent(const Formula &f) const
+// Destroying a long chain of nodes would recurse once per node, so operands
+// that are about to be freed are queued and freed one at a time by the
+// outermost call.
+void BaseFormula::release(Formula &f)
 {
-	AtomSet as;
-	getAtoms(as);
-	f->getAtoms(as);
-	Valuation v(as);
+	static thread_local vector<Formula> *queue = nullptr;
+
+	if(f.use_count() != 1)
+		return;
 
-	do
+	if(queue != nullptr)
 	{
-		if(eval(v) != f->eval(v))
-			return false;
-	} while(v.next());
+		queue->push_back(move(f));
+		return;
+	}
 
-	return true;
+	vector<Formula> pending;
+	queue = &pending;
+	pending.push_back(move(f));
+
+	while(!pending.empty())
+	{
+		// destroying g queues its operands
+		Formula g = move(pending.back());
+		pending.pop_back();
+	}
+
+	queue = nullptr;
 }
 
-void BaseFormula::printTruthTable() const
+void BaseFormula::getAtoms(AtomSet &as) const
 {
-	AtomSet as;
-	getAtoms(as);
-	Valuation v(as);
+	PostOrder order(this);
 
-	do
+	for(size_t i = 0; i < order.size(); i++)
+		if(order.node(i)->getType() == T_ATOM)
+			as.insert(((Atom*) order.node(i))->getId());
+}
+
+Formula BaseFormula::simplify()
+{
+	PostOrder order(this);
+	vector<Formula> res(order.size());
+
+	for(size_t i = 0; i < order.size(); i++)
+		res[i] = order.node(i)->simplifyNode(res[order.op1(i)], res[order.op2(i)]);
+
+	return res.back();
+}
+
+Formula BaseFormula::pushNegation()
+{
+	return rewriteNegations(false);
+}
+
+Formula BaseFormula::nnf()
+{
+	return rewriteNegations(true);
+}
+
+// Pushes negations inwards; equivalences are kept (pushNegation) or expanded
+// (nnf). The first loop marks, from the root down, whether each node, its
+// negation or both are needed, and the second builds exactly those.
+Formula BaseFormula::rewriteNegations(bool expandIff)
+{
+	PostOrder order(this);
+	vector<char> need(order.size() - 1, 0);
+	vector<Polarized> res(order.size());
+	Formula (BaseFormula::*step)(const Polarized&, const Polarized&, bool) =
+		expandIff ? &BaseFormula::nnfNode : &BaseFormula::pushNegationNode;
+
+	need.push_back(P_POS);
+	for(size_t i = order.size(); i-- > 0; )
 	{
-		cout << v << " | " << eval(v) << endl;
-	} while(v.next());
+		int need1, need2;
+		operandPolarities(order.node(i)->getType(), expandIff, need[i], need1, need2);
+		need[order.op1(i)] |= need1;
+		need[order.op2(i)] |= need2;
+	}
+
+	for(size_t i = 0; i < order.size(); i++)
+	{
+		BaseFormula *f = order.node(i);
+		const Polarized &op1 = res[order.op1(i)], &op2 = res[order.op2(i)];
+
+		if(need[i] & P_POS)
+			res[i].pos = (f->*step)(op1, op2, false);
+		if(need[i] & P_NEG)
+			res[i].neg = (f->*step)(op1, op2, true);
+	}
+
+	return res.back().pos;
 }
 
-bool BaseFormula::isTautology() const
+// to evaluate a formula repeatedly, compile it into a Bytecode once instead
+bool BaseFormula::eval(const Valuation &v) const
 {
-	AtomSet as;
-	getAtoms(as);
-	Valuation v(as);
+	return Bytecode(this).eval(v);
+}
 
-	do
+// structurally equal formulas made through FormulaFactory are the same node,
+// so two distinct interned nodes are never equal
+bool BaseFormula::equals(const Formula &f) const
+{
+	vector<pair<const BaseFormula*, const BaseFormula*>> stack(1, make_pair(this, f.get()));
+
+	while(!stack.empty())
 	{
-		if(eval(v) == false)
+		const BaseFormula *f1 = stack.back().first, *f2 = stack.back().second;
+		stack.pop_back();
+
+		if(f1 == f2)
+			continue;
+		if((f1->_interned && f2->_interned) || !f1->equalsNode(f2))
 			return false;
-	} while(v.next());
+
+		const BaseFormula *op11, *op12, *op21, *op22;
+		getOperands(f1, op11, op12);
+		getOperands(f2, op21, op22);
+
+		if(op12 != nullptr)
+			stack.push_back(make_pair(op12, op22));
+		if(op11 != nullptr)
+			stack.push_back(make_pair(op11, op21));
+	}
 
 	return true;
 }
 
-bool BaseFormula::isSat(Valuation &v) const
+// compares the node itself, the operands are compared by equals
+bool BaseFormula::equalsNode(const BaseFormula *f) const
 {
-	AtomSet as;
-	getAtoms(as);
-	v = Valuation(as);
+	return getType() == f->getType();
+}
 
-	do
+void BaseFormula::print(ostream &ostr) const
+{
+	PrintStack stack(1, PrintStack::value_type(this, nullptr));
+
+	while(!stack.empty())
 	{
-		if(eval(v) == true)
-			return true;
-	} while(v.next());
+		PrintStack::value_type item = stack.back();
+		stack.pop_back();
 
-	return false;
+		if(item.first == nullptr)
+			ostr << item.second;
+		else
+			item.first->printNode(ostr, stack);
+	}
 }
 
-Formula BaseFormula::tseitinTransformation()
+void BaseFormula::flatCNF(Cnf &cnf) const
 {
-	AtomSet as;
-	Formula simpl = simplify()->pushNegation();
-	simpl->getAtoms(as);
-	Formula tmp = nullptr;
-	Formula res = _tseitin(simpl, as, tmp);
+	FormulaPool pool;
 
-	if(tmp.get() == nullptr)
-		return res;
-	else
-		return make_shared<And>(res, tmp);
+	pool.flatCNF(pool.import(const_pointer_cast<BaseFormula>(shared_from_this())), cnf);
+}
+
+// Decides f with the SatSolver on its Tseitin clauses, simplified with the
+// fresh atoms eliminated where possible. If v is given and f is satisfiable,
+// the atoms in as are set as in the model found.
+static bool solve(const Formula &f, const AtomSet &as, Valuation *v)
+{
+	FormulaPool pool;
+	Cnf cnf;
+	unsigned fresh = pool.tseitinCNF(pool.import(f), cnf, TM_POLARITY);
+
+	CnfSimplifier simplifier(cnf);
+	for(unsigned var = 1; var < fresh; var++)
+		simplifier.freeze(var);
+	simplifier.run(true);
+
+	SatSolver solver(cnf);
+	if(!solver.solve())
+		return false;
+
+	// atoms that got no clause can have any value
+	unsigned n = cnf.numVariables();
+	if(v != nullptr)
+		for(const string &i : as)
+		{
+			unsigned var = cnf.getVariable(i);
+			v->setValue(i, var <= n && solver.getValue(var));
+		}
+
+	return true;
 }
 
-Formula BaseFormula::_tseitin(const Formula &f, AtomSet &as, Formula &tmp) const
+// Compares f and g by their BDDs and sets equal, unless the BDDs get more
+// than Bdd::MAX_NODES nodes, in which case it returns false.
+static bool bddEquivalent(const Formula &f, const Formula &g, bool &equal)
 {
-	if(isNATF(f))
-		return f;
+	FormulaPool pool;
+	NodeId a = pool.import(f);
+	NodeId b = pool.import(g);
 
-	// apply transformation on subformulas
-	Formula ts1 = _tseitin(((BinaryConnective*) f.get())->getOp1(), as, tmp);
-	Formula ts2 = _tseitin(((BinaryConnective*) f.get())->getOp2(), as, tmp);
+	Bdd bdd(pool);
+	Bdd::Ref fa = bdd.build(a);
+	Bdd::Ref fb = fa != Bdd::NONE ? bdd.build(b) : Bdd::NONE;
+	if(fb == Bdd::NONE)
+		return false;
 
-	// make new atom
-	string id = getUniqueId(as);
-	Formula atom = make_shared<Atom>(id);
-	as.insert(id);
+	equal = fa == fb;
+	return true;
+}
+
+// The exhaustive checks below evaluate BitEvaluator::LANES valuations at a
+// time, in the order of Valuation::next. If workers are given, the
+// valuations are split among them, see BitEvaluator::search. Formulas with
+// more than SOLVER_ATOMS atoms are compared by their BDDs instead, and if
+// those get too large, given to the SatSolver.
+bool BaseFormula::isEquivalent(const Formula &f, ThreadPool *workers) const
+{
+	AtomSet as;
+	getAtoms(as);
+	f->getAtoms(as);
+	Formula self = const_pointer_cast<BaseFormula>(shared_from_this());
 
-	Formula conn;
-	switch(f->getType())
+	// the BDDs are compared first, their equivalence is only built if the
+	// solver has to show that it is never false
+	if(as.size() > SOLVER_ATOMS)
 	{
-		case T_AND:
-			conn = make_shared<And>(ts1, ts2);
-			break;
-		case T_OR:
-			conn = make_shared<Or>(ts1, ts2);
-			break;
-		case T_IMP:
-			conn = make_shared<Imp>(ts1, ts2);
-			break;
-		case T_IFF:
-			conn = make_shared<Iff>(ts1, ts2);
-			break;
+		bool equal;
+		if(bddEquivalent(self, f, equal))
+			return equal;
+		return !solve(FormulaFactory::makeNot(FormulaFactory::makeIff(self, f)), as, nullptr);
 	}
 
-	if(tmp.get() == nullptr)
-		tmp = make_shared<Iff>(atom, conn);
-	else
-		tmp = make_shared<And>(tmp, make_shared<Iff>(atom, conn));
+	Valuation v(as);
+	Formula iff = FormulaFactory::makeIff(self, f);
 
-	return atom;
+	return BitEvaluator::search(Bytecode(iff.get()), v, false, workers) == BitEvaluator::NOT_FOUND;
 }
 
-//-----------------------------------------------------------------------------
-// List functions
-//-----------------------------------------------------------------------------
-template <typename T> T concatenateLists(const T &l1, const T &l2)
+void BaseFormula::printTruthTable() const
+{
+	AtomSet as;
+	getAtoms(as);
+	Valuation v(as);
+	BitEvaluator e(Bytecode(this), v);
+
+	for(uint64_t first = 0; first < e.numValuations(); first += BitEvaluator::LANES)
+	{
+		const uint64_t *r = e.eval(first);
+		unsigned lanes = min<uint64_t>(BitEvaluator::LANES, e.numValuations() - first);
+
+		for(unsigned j = 0; j < lanes; j++)
+		{
+			v.assign(first + j);
+			cout << v << " | " << ((r[j / 64] >> (j % 64)) & 1) << endl;
+		}
+	}
+}
+
+bool BaseFormula::isTautology(ThreadPool *workers) const
 {
-	T l = l1;
-	copy(l2.begin(), l2.end(), back_inserter(l));
+	AtomSet as;
+	getAtoms(as);
+	Formula self = const_pointer_cast<BaseFormula>(shared_from_this());
+	if(as.size() > SOLVER_ATOMS)
+	{
+		bool taut;
+		return bddEquivalent(self, FormulaFactory::makeTrue(), taut) ? taut : !solve(FormulaFactory::makeNot(self), as, nullptr);
+	}
 
-	return l;
+	Valuation v(as);
+	return BitEvaluator::search(Bytecode(this), v, false, workers) == BitEvaluator::NOT_FOUND;
 }
 
-LiteralListList makePairs(const LiteralListList &ll1, const LiteralListList &ll2)
+// sets v to the first satisfying valuation, or to all false if there is none;
+// above SOLVER_ATOMS atoms it is the one the SatSolver finds
+bool BaseFormula::isSat(Valuation &v, ThreadPool *workers) const
 {
-	LiteralListList ll;
+	AtomSet as;
+	getAtoms(as);
+	v = Valuation(as);
+	if(as.size() > SOLVER_ATOMS)
+		return solve(const_pointer_cast<BaseFormula>(shared_from_this()), as, &v);
 
-	for (auto &l1 : ll1)
-		for (auto &l2 : ll2)
-			ll.push_back(concatenateLists(l1, l2));
+	uint64_t n = BitEvaluator::search(Bytecode(this), v, true, workers);
+	if(n == BitEvaluator::NOT_FOUND)
+		return false;
 
-	return ll;
+	v.assign(n);
+	return true;
+}
+
+// the transformation itself runs on a FormulaPool, see formula_pool.cpp
+Formula BaseFormula::tseitinTransformation(TseitinMode mode)
+{
+	FormulaPool pool;
+
+	return pool.toFormula(pool.tseitinTransformation(pool.import(shared_from_this()), mode));
 }
 
 //-----------------------------------------------------------------------------
-// AtomicFormula
+// PostOrder
 //-----------------------------------------------------------------------------
-Formula AtomicFormula::simplify()
+PostOrder::PostOrder(const BaseFormula *root)
 {
-	return shared_from_this();
+	unordered_map<const BaseFormula*, size_t> index;
+	vector<const BaseFormula*> stack(1, root);
+
+	while(!stack.empty())
+	{
+		const BaseFormula *f = stack.back();
+		if(index.find(f) != index.end())
+		{
+			stack.pop_back();
+			continue;
+		}
+
+		// operands are added first, f is visited again once they are
+		const BaseFormula *op1, *op2;
+		getOperands(f, op1, op2);
+
+		auto i1 = op1 ? index.find(op1) : index.end();
+		auto i2 = op2 ? index.find(op2) : index.end();
+		bool ready = true;
+
+		if(op2 && i2 == index.end())
+		{
+			stack.push_back(op2);
+			ready = false;
+		}
+		if(op1 && i1 == index.end())
+		{
+			stack.push_back(op1);
+			ready = false;
+		}
+		if(!ready)
+			continue;
+
+		stack.pop_back();
+
+		size_t i = _nodes.size();
+		index.insert(make_pair(f, i));
+		// nodes are not changed through the order, only their steps are called
+		_nodes.push_back(const_cast<BaseFormula*>(f));
+		_ops.push_back(op1 ? i1->second : i);
+		_ops.push_back(op2 ? i2->second : i);
+	}
 }
 
-Formula AtomicFormula::pushNegation()
+//-----------------------------------------------------------------------------
+// AtomicFormula
+//-----------------------------------------------------------------------------
+Formula AtomicFormula::simplifyNode(const Formula&, const Formula&)
 {
 	return shared_from_this();
 }
 
-Formula AtomicFormula::nnf()
+Formula AtomicFormula::pushNegationNode(const Polarized&, const Polarized&, bool negated)
 {
-	return shared_from_this();
+	return negated ? FormulaFactory::makeNot(shared_from_this()) : shared_from_this();
 }
 
-//-----------------------------------------------------------------------------
-// LogicConstant
-//-----------------------------------------------------------------------------
-void LogicConstant::getAtoms(AtomSet &as) const
-{}
-
-bool LogicConstant::equals(const Formula &f) const
+Formula AtomicFormula::nnfNode(const Polarized &op1, const Polarized &op2, bool negated)
 {
-	return getType() == f->getType();
+	return pushNegationNode(op1, op2, negated);
 }
 
 //-----------------------------------------------------------------------------
@@ -185,21 +442,11 @@ Type True::getType() const
 	return T_TRUE;
 }
 
-void True::print(ostream &ostr) const
+void True::printNode(ostream &ostr, PrintStack&) const
 {
 	ostr << "TRUE";
 }
 
-bool True::eval(const Valuation &v) const
-{
-	return true;
-}
-
-LiteralListList True::flatCNF()
-{
-	return { };
-}
-
 //-----------------------------------------------------------------------------
 // False
 //-----------------------------------------------------------------------------
@@ -208,60 +455,40 @@ Type False::getType() const
 	return T_FALSE;
 }
 
-void False::print(ostream &ostr) const
+void False::printNode(ostream &ostr, PrintStack&) const
 {
 	ostr << "FALSE";
 }
 
-bool False::eval(const Valuation &v) const
-{
-	return false;
-}
-
-LiteralListList False::flatCNF()
-{
-	return {{}};
-}
-
 //-----------------------------------------------------------------------------
 // Atom
 //-----------------------------------------------------------------------------
-Atom::Atom(const string &id)
-	: _id(id) {}
+Atom::Atom(const string &id, unsigned symbol)
+	: _id(id), _symbol(symbol) {}
 
 Type Atom::getType() const
 {
 	return T_ATOM;
 }
 
-void Atom::getAtoms(AtomSet &as) const
-{
-	as.insert(_id);
-}
-
-bool Atom::equals(const Formula &f) const
+bool Atom::equalsNode(const BaseFormula *f) const
 {
-	return getType() == f->getType() && _id == ((Atom*) f.get())->_id;
+	return getType() == f->getType() && _symbol == ((const Atom*) f)->_symbol;
 }
 
-void Atom::print(ostream &ostr) const
+void Atom::printNode(ostream &ostr, PrintStack&) const
 {
 	ostr << _id;
 }
 
-bool Atom::eval(const Valuation &v) const
-{
-	return v.getValue(_id);
-}
-
 string Atom::getId() const
 {
 	return _id;
 }
 
-LiteralListList Atom::flatCNF()
+unsigned Atom::getSymbol() const
 {
-	return { { shared_from_this() } };
+	return _symbol;
 }
 
 //-----------------------------------------------------------------------------
@@ -270,19 +497,14 @@ LiteralListList Atom::flatCNF()
 UnaryConnective::UnaryConnective(const Formula &op)
 	: _op(op) {}
 
-const Formula& UnaryConnective::getOp() const
+UnaryConnective::~UnaryConnective()
 {
-	return _op;
+	release(_op);
 }
 
-void UnaryConnective::getAtoms(AtomSet &as) const
-{
-	_op->getAtoms(as);
-}
-
-bool UnaryConnective::equals(const Formula &f) const
+const Formula& UnaryConnective::getOp() const
 {
-	return getType() == f->getType() && _op->equals(((UnaryConnective*) f.get())->_op);
+	return _op;
 }
 
 //-----------------------------------------------------------------------------
@@ -293,110 +515,39 @@ Type Not::getType() const
 	return T_NOT;
 }
 
-Formula Not::simplify()
+Formula Not::simplifyNode(const Formula &simp, const Formula&)
 {
-	Formula simp = _op->simplify();
-
 	if(simp->getType() == T_FALSE)
-		return make_shared<True>();
+		return FormulaFactory::makeTrue();
 	else if(simp->getType() == T_TRUE)
-		return make_shared<False>();
+		return FormulaFactory::makeFalse();
+	else if(simp == _op)
+		return shared_from_this();
 	else
-		return make_shared<Not>(simp);
+		return FormulaFactory::makeNot(simp);
 }
 
-Formula Not::pushNegation()
+Formula Not::pushNegationNode(const Polarized &op, const Polarized&, bool negated)
 {
-	if(_op->getType() == T_NOT)
-	{
-		return ((Not*) _op.get())->_op->pushNegation();
-	}
-	else if(_op->getType() == T_AND)
-	{
-		And *tmp = (And*) _op.get();
-
-		return make_shared<Or>(make_shared<Not>(tmp->getOp1())->pushNegation(), make_shared<Not>(tmp->getOp2()->pushNegation()));
-	}
-	else if(_op->getType() == T_OR)
-	{
-		Or *tmp = (Or*) _op.get();
-
-		return make_shared<And>(make_shared<Not>(tmp->getOp1())->pushNegation(), make_shared<Not>(tmp->getOp2())->pushNegation());
-	}
-	else if(_op->getType() == T_IMP)
-	{
-		Imp *tmp = (Imp*) _op.get();
-
-		return make_shared<And>(tmp->getOp1()->pushNegation(), make_shared<Not>(tmp->getOp2())->pushNegation());
-	}
-	else if(_op->getType() == T_IFF)
-	{
-		Iff *tmp = (Iff*) _op.get();
-
-		return make_shared<Iff>(make_shared<Not>(tmp->getOp1())->pushNegation(), tmp->getOp2()->pushNegation());
-	}
-	else
-	{
-		return shared_from_this();
-	}
+	return negated ? op.pos : op.neg;
 }
 
-void Not::print(ostream &ostr) const
+void Not::printNode(ostream &ostr, PrintStack &stack) const
 {
 	if(!isNATF(_op))
-		ostr << "¬(" << _op << ")";
+	{
+		ostr << "¬(";
+		stack.push_back(PrintStack::value_type(nullptr, ")"));
+	}
 	else
-		ostr << "¬" << _op;
-}
-
-bool Not::eval(const Valuation &v) const
-{
-	return !_op->eval(v);
-}
+		ostr << "¬";
 
-LiteralListList Not::flatCNF()
-{
-	return { { shared_from_this() } };
+	stack.push_back(PrintStack::value_type(_op.get(), nullptr));
 }
 
-Formula Not::nnf()
+Formula Not::nnfNode(const Polarized &op1, const Polarized &op2, bool negated)
 {
-	if(_op->getType() == T_NOT)
-	{
-		Not *notOp = (Not*)_op.get();
-
-		return notOp->getOperand()->nnf();
-	}
-	else if(_op->getType() == T_AND)
-	{
-		And *andOp = (And*)_op.get();
-
-		return make_shared<Or>(make_shared<Not>(andOp->getOperand1())->nnf(), make_shared<Not>(andOp->getOperand2())->nnf());
-	}
-	else if(_op->getType() == T_OR)
-	{
-		Or *orOp = (Or*)_op.get();
-
-		return make_shared<And>(make_shared<Not>(orOp->getOperand1())->nnf(), make_shared<Not>(orOp->getOperand2())->nnf());
-	}
-	else if(_op->getType() == T_IMP)
-	{
-		Imp *impOp = (Imp*)_op.get();
-
-		return make_shared<And>(impOp->getOperand1()->nnf(), make_shared<Not>(impOp->getOperand2())->nnf());
-
-	}
-	else if(_op->getType() == T_IFF)
-	{
-		Iff *iffOp = (Iff*)_op.get();
-
-		return make_shared<Or>(make_shared<And>(iffOp->getOperand1()->nnf(), make_shared<Not>(iffOp->getOperand2())->nnf()),
-			make_shared<And>(iffOp->getOperand2()->nnf(), make_shared<Not>(iffOp->getOperand1())->nnf()));
-	}
-	else
-	{
-		return shared_from_this();
-	}
+	return pushNegationNode(op1, op2, negated);
 }
 
 //-----------------------------------------------------------------------------
@@ -405,6 +556,12 @@ Formula Not::nnf()
 BinaryConnective::BinaryConnective(const Formula &op1, const Formula &op2)
 	: _op1(op1), _op2(op2) {}
 
+BinaryConnective::~BinaryConnective()
+{
+	release(_op1);
+	release(_op2);
+}
+
 const Formula& BinaryConnective::getOp1() const
 {
 	return _op1;
@@ -415,44 +572,65 @@ const Formula& BinaryConnective::getOp2() const
 	return _op2;
 }
 
-void BinaryConnective::getAtoms(AtomSet &as) const
+// returns this node if its operands are op1 and op2, so that a rewrite that
+// changes nothing allocates nothing, or else the same connective over them
+Formula BinaryConnective::remake(const Formula &op1, const Formula &op2)
 {
-	_op1->getAtoms(as);
-	_op2->getAtoms(as);
-}
+	if(op1 == _op1 && op2 == _op2)
+		return shared_from_this();
 
-bool BinaryConnective::equals(const Formula &f) const
-{
-	return getType() == f->getType() && _op1->equals(((BinaryConnective*) f.get())->_op1) && _op2->equals(((BinaryConnective*) f.get())->_op2);
+	switch(getType())
+	{
+		case T_AND:
+			return FormulaFactory::makeAnd(op1, op2);
+		case T_OR:
+			return FormulaFactory::makeOr(op1, op2);
+		case T_IMP:
+			return FormulaFactory::makeImp(op1, op2);
+		default:
+			return FormulaFactory::makeIff(op1, op2);
+	}
 }
 
-void BinaryConnective::print(ostream &ostr) const
+// prints what comes before op1 and leaves the rest on the stack
+void BinaryConnective::printNode(ostream &ostr, PrintStack &stack) const
 {
-	if(!(_op1->getType() == getType() || isNATF(_op1)))
-		ostr << "(" << _op1 << ")";
-	else
-		ostr << _op1;
+	// the parser groups from the left, so only a left operand of the same
+	// type goes without parentheses
+	bool paren1 = !(_op1->getType() == getType() || isNATF(_op1));
+	bool paren2 = !isNATF(_op2);
+	const char *conn = "";
 
 	switch(getType())
 	{
 		case T_AND:
-			ostr << " /\\ ";
+			conn = " /\\ ";
 			break;
 		case T_OR:
-			ostr << " \\/ ";
+			conn = " \\/ ";
 			break;
 		case T_IMP:
-			ostr << " => ";
+			conn = " => ";
 			break;
 		case T_IFF:
-			ostr << " <=> ";
+			conn = " <=> ";
+			break;
+		default:
 			break;
 	}
 
-	if(!(_op2->getType() == getType() || isNATF(_op2)))
-		ostr << "(" << _op2 << ")";
-	else
-		ostr << _op2;
+	if(paren2)
+		stack.push_back(PrintStack::value_type(nullptr, ")"));
+	stack.push_back(PrintStack::value_type(_op2.get(), nullptr));
+	if(paren2)
+		stack.push_back(PrintStack::value_type(nullptr, "("));
+	stack.push_back(PrintStack::value_type(nullptr, conn));
+	if(paren1)
+		stack.push_back(PrintStack::value_type(nullptr, ")"));
+	stack.push_back(PrintStack::value_type(_op1.get(), nullptr));
+
+	if(paren1)
+		ostr << "(";
 }
 
 //-----------------------------------------------------------------------------
@@ -463,43 +641,28 @@ Type And::getType() const
 	return T_AND;
 }
 
-Formula And::simplify()
+Formula And::simplifyNode(const Formula &simp1, const Formula &simp2)
 {
-	Formula simp1 = _op1->simplify();
-	Formula simp2 = _op2->simplify();
-
 	if(simp1->getType() == T_TRUE)
 		return simp2;
 	else if(simp2->getType() == T_TRUE)
 		return simp1;
 	else if(simp1->getType() == T_FALSE || simp2->getType() == T_FALSE)
-		return make_shared<False>();
+		return FormulaFactory::makeFalse();
 	else
-		return make_shared<And>(simp1, simp2);
-}
-
-Formula And::pushNegation()
-{
-	return make_shared<And>(_op1->pushNegation(), _op2->pushNegation());
+		return remake(simp1, simp2);
 }
 
-bool And::eval(const Valuation &v) const
+Formula And::pushNegationNode(const Polarized &op1, const Polarized &op2, bool negated)
 {
-	return _op1->eval(v) && _op2->eval(v);
+	return negated ? FormulaFactory::makeOr(op1.neg, op2.neg) : remake(op1.pos, op2.pos);
 }
 
-LiteralListList And::flatCNF()
+Formula And::nnfNode(const Polarized &op1, const Polarized &op2, bool negated)
 {
-	LiteralListList cl1 = _op1->flatCNF();
-	LiteralListList cl2 = _op2->flatCNF();
-
-	return concatenateLists(cl1, cl2);
+	return pushNegationNode(op1, op2, negated);
 }
 
-Formula And::nnf()
-{
-	return make_shared<And>(_op1->nnf(), _op2->nnf());
-}
 //-----------------------------------------------------------------------------
 // Or
 //-----------------------------------------------------------------------------
@@ -508,42 +671,26 @@ Type Or::getType() const
 	return T_OR;
 }
 
-Formula Or::simplify()
+Formula Or::simplifyNode(const Formula &simp1, const Formula &simp2)
 {
-	Formula simp1 = _op1->simplify();
-	Formula simp2 = _op2->simplify();
-
 	if(simp1->getType() == T_TRUE || simp2->getType() == T_TRUE)
-		return make_shared<True>();
+		return FormulaFactory::makeTrue();
 	else if(simp1->getType() == T_FALSE)
 		return simp2;
 	else if(simp2->getType() == T_FALSE)
 		return simp1;
 	else
-		return make_shared<Or>(simp1, simp2);
-}
-
-Formula Or::pushNegation()
-{
-	return make_shared<Or>(_op1->pushNegation(), _op2->pushNegation());
-}
-
-bool Or::eval(const Valuation &v) const
-{
-	return _op1->eval(v) || _op2->eval(v);
+		return remake(simp1, simp2);
 }
 
-LiteralListList Or::flatCNF()
+Formula Or::pushNegationNode(const Polarized &op1, const Polarized &op2, bool negated)
 {
-  LiteralListList cl1 = _op1->flatCNF();
-  LiteralListList cl2 = _op2->flatCNF();
-
-  return makePairs(cl1, cl2);
+	return negated ? FormulaFactory::makeAnd(op1.neg, op2.neg) : remake(op1.pos, op2.pos);
 }
 
-Formula Or::nnf()
+Formula Or::nnfNode(const Polarized &op1, const Polarized &op2, bool negated)
 {
-	return make_shared<Or>(_op1->nnf(), _op2->nnf());
+	return pushNegationNode(op1, op2, negated);
 }
 
 //-----------------------------------------------------------------------------
@@ -554,39 +701,26 @@ Type Imp::getType() const
 	return T_IMP;
 }
 
-Formula Imp::simplify()
+Formula Imp::simplifyNode(const Formula &simp1, const Formula &simp2)
 {
-	Formula simp1 = _op1->simplify();
-	Formula simp2 = _op2->simplify();
-
 	if(simp2->getType() == T_TRUE || simp1->getType() == T_FALSE)
-		return make_shared<True>();
+		return FormulaFactory::makeTrue();
 	else if(simp1->getType() == T_TRUE)
 		return simp2;
 	else if(simp2->getType() == T_FALSE)
-		return make_shared<Not>(simp1);
+		return FormulaFactory::makeNot(simp1);
 	else
-		return make_shared<Imp>(simp1, simp2);
-}
-
-Formula Imp::pushNegation()
-{
-	return make_shared<Or>(make_shared<Not>(_op1)->pushNegation(), _op2->pushNegation());
+		return remake(simp1, simp2);
 }
 
-bool Imp::eval(const Valuation &v) const
+Formula Imp::pushNegationNode(const Polarized &op1, const Polarized &op2, bool negated)
 {
-	return !_op1->eval(v) || _op2->eval(v);
+	return negated ? FormulaFactory::makeAnd(op1.pos, op2.neg) : FormulaFactory::makeOr(op1.neg, op2.pos);
 }
 
-LiteralListList Imp::flatCNF()
+Formula Imp::nnfNode(const Polarized &op1, const Polarized &op2, bool negated)
 {
-	assert(!"HAHA1");
-}
-
-Formula Imp::nnf()
-{
-	return make_shared<Or>(make_shared<Not>(_op1)->nnf(), _op2->nnf());
+	return pushNegationNode(op1, op2, negated);
 }
 
 //-----------------------------------------------------------------------------
@@ -597,123 +731,264 @@ Type Iff::getType() const
 	return T_IFF;
 }
 
-Formula Iff::simplify()
+Formula Iff::simplifyNode(const Formula &simp1, const Formula &simp2)
 {
-	Formula simp1 = _op1->simplify();
-	Formula simp2 = _op2->simplify();
-
 	if(simp1->getType() == T_FALSE && simp2->getType() == T_FALSE)
-		return make_shared<True>();
+		return FormulaFactory::makeTrue();
 	else if(simp1->getType() == T_TRUE)
 		return simp2;
 	else if(simp2->getType() == T_TRUE)
 		return simp1;
 	else if(simp1->getType() == T_FALSE)
-		return make_shared<Not>(simp2);
+		return FormulaFactory::makeNot(simp2);
 	else if(simp2->getType() == T_FALSE)
-		return make_shared<Not>(simp1);
+		return FormulaFactory::makeNot(simp1);
 	else
-		return make_shared<Iff>(simp1, simp2);
-}
-
-Formula Iff::pushNegation()
-{
-	return make_shared<Iff>(_op1->pushNegation(), _op2->pushNegation());
-}
-
-bool Iff::eval(const Valuation &v) const
-{
-	return _op1->eval(v) == _op2->eval(v);
+		return remake(simp1, simp2);
 }
 
-LiteralListList Iff::flatCNF()
+Formula Iff::pushNegationNode(const Polarized &op1, const Polarized &op2, bool negated)
 {
-	assert(!"HAHA2");
+	return negated ? FormulaFactory::makeIff(op1.neg, op2.pos) : remake(op1.pos, op2.pos);
 }
 
-Formula Iff::nnf()
+Formula Iff::nnfNode(const Polarized &op1, const Polarized &op2, bool negated)
 {
-	return make_shared<And>(make_shared<Or>(make_shared<Not>(_op1)->nnf(), _op2->nnf()), make_shared<Or>(make_shared<Not>(_op2)->nnf(), _op1->nnf()));
+	if(negated)
+		return FormulaFactory::makeOr(FormulaFactory::makeAnd(op1.pos, op2.neg), FormulaFactory::makeAnd(op2.pos, op1.neg));
+	else
+		return FormulaFactory::makeAnd(FormulaFactory::makeOr(op1.neg, op2.pos), FormulaFactory::makeOr(op2.neg, op1.pos));
 }
 
 //-----------------------------------------------------------------------------
 // Valuation
 //-----------------------------------------------------------------------------
+const unsigned Valuation::NONE;
+
+// all atoms start false
 Valuation::Valuation(const AtomSet &as)
+	: _words((as.size() + 63) / 64, 0)
 {
+	unsigned b = as.size();
+
 	for(const string &i : as)
-		_vars.insert(make_pair(i, false));
+	{
+		unsigned symbol = FormulaFactory::getSymbol(i);
+
+		if(symbol >= _bits.size())
+			_bits.resize(symbol + 1, NONE);
+
+		_symbols.push_back(symbol);
+		_bits[symbol] = --b;
+	}
 }
 
 bool Valuation::getValue(const string &str) const
 {
-	return _vars.find(str)->second;
+	return getValue(FormulaFactory::getSymbol(str));
 }
 
-void Valuation::setValue(string &str, bool val)
+void Valuation::setValue(const string &str, bool val)
 {
-	_vars[str] = val;
+	unsigned symbol = FormulaFactory::getSymbol(str);
+	assert(symbol < _bits.size() && _bits[symbol] != NONE && "atom is not in the valuation");
+	unsigned b = _bits[symbol];
+
+	if(val)
+		_words[b >> 6] |= 1ULL << (b & 63);
+	else
+		_words[b >> 6] &= ~(1ULL << (b & 63));
 }
 
+// moves to the next valuation, after the last one it wraps around to all
+// false and returns false
 bool Valuation::next()
 {
-	for(auto i = _vars.rbegin(), k = _vars.rend(); i != k; i++)
+	for(size_t w = 0; w < _words.size(); w++)
 	{
-		i->second = !i->second;
-		if(i->second != false)
+		_words[w]++;
+
+		// the top word only holds the bits that are left
+		size_t used = _symbols.size() - 64 * w;
+		if(used < 64 && _words[w] == 1ULL << used)
+		{
+			_words[w] = 0;
+			return false;
+		}
+
+		if(_words[w] != 0)
 			return true;
 	}
+
 	return false;
 }
 
+// sets the valuation to the one reached from all false by n calls of next
+void Valuation::assign(uint64_t n)
+{
+	for(uint64_t &w : _words)
+		w = 0;
+	if(!_words.empty())
+		_words[0] = n;
+}
+
 void Valuation::print(ostream &ostr) const
 {
-	for(auto b = _vars.cbegin(), e = _vars.cend(); b != e; b++)
+	for(unsigned symbol : _symbols)
 	{
-		ostr << b->second << " ";
+		ostr << getValue(symbol) << " ";
 	}
 }
 
 //-----------------------------------------------------------------------------
-// Support functions
+// FormulaFactory
 //-----------------------------------------------------------------------------
-ostream& operator<<(ostream &ostr, const Formula &f)
+mutex FormulaFactory::_mutex;
+FormulaFactory::UniqueTable FormulaFactory::_connectives;
+SymbolTable FormulaFactory::_symbols;
+FormulaFactory::AtomTable FormulaFactory::_atoms;
+size_t FormulaFactory::_connectivesLimit = 1024;
+size_t FormulaFactory::_atomsLimit = 1024;
+
+size_t FormulaFactory::KeyHash::operator()(const Key &k) const
 {
-	f->print(ostr);
-	return ostr;
+	size_t h = hash<const void*>()(k.op1);
+	h ^= hash<const void*>()(k.op2) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+
+	return h ^ (size_t) k.type;
 }
 
-ostream& operator<<(ostream &ostr, const Valuation &v)
+// drops entries of nodes that no longer exist once the table doubles in size
+template <typename Table> void FormulaFactory::purge(Table &table, size_t &limit)
 {
-	v.print(ostr);
-	return ostr;
+	if(table.size() < limit)
+		return;
+
+	for(auto i = table.begin(); i != table.end(); )
+	{
+		if(i->second.expired())
+			i = table.erase(i);
+		else
+			i++;
+	}
+
+	limit = 2 * table.size() + 1024;
+}
+
+Formula FormulaFactory::intern(BaseFormula *f)
+{
+	Formula res(f);
+	res->_interned = true;
+
+	return res;
 }
 
-string getUniqueId(const AtomSet &as)
+template <typename T> Formula FormulaFactory::makeConnective(Type t, const Formula &op1, const Formula &op2)
 {
-	static unsigned id = 0;
+	lock_guard<mutex> lock(_mutex);
+	purge(_connectives, _connectivesLimit);
+
+	weak_ptr<BaseFormula> &entry = _connectives[Key{t, op1.get(), op2.get()}];
+	Formula res = entry.lock();
 
-	do
+	if(res.get() == nullptr)
 	{
-		++id;
-	} while (as.find("s" + to_string(id)) != as.cend());
+		res = intern(new T(op1, op2));
+		entry = res;
+	}
 
-	return "s" + to_string(id);
+	return res;
 }
 
-ostream& operator<<(ostream &ostr, const LiteralListList &l)
+Formula FormulaFactory::makeTrue()
 {
-	ostr << "[ ";
-	for(auto & ll :  l)
-	{
-		ostr << "[ ";
-		for(auto & f : ll)
+	static Formula t = intern(new True());
+
+	return t;
+}
+
+Formula FormulaFactory::makeFalse()
+{
+	static Formula f = intern(new False());
+
+	return f;
+}
+
+Formula FormulaFactory::makeAtom(const string &id)
+{
+	lock_guard<mutex> lock(_mutex);
+	unsigned symbol = _symbols.intern(id.data(), id.size());
+
+	purge(_atoms, _atomsLimit);
+	weak_ptr<BaseFormula> &entry = _atoms[symbol];
+	Formula res = entry.lock();
+
+	if(res.get() == nullptr)
 	{
-		ostr << f << " ";
+		res = intern(new Atom(id, symbol));
+		entry = res;
 	}
-		ostr << "] ";
+
+	return res;
+}
+
+// returns the symbol of the atom with the given name, the same as
+// makeAtom(id)->getSymbol() but without making the atom
+unsigned FormulaFactory::getSymbol(const string &id)
+{
+	lock_guard<mutex> lock(_mutex);
+
+	return _symbols.intern(id.data(), id.size());
+}
+
+Formula FormulaFactory::makeNot(const Formula &op)
+{
+	lock_guard<mutex> lock(_mutex);
+	purge(_connectives, _connectivesLimit);
+
+	weak_ptr<BaseFormula> &entry = _connectives[Key{T_NOT, op.get(), nullptr}];
+	Formula res = entry.lock();
+
+	if(res.get() == nullptr)
+	{
+		res = intern(new Not(op));
+		entry = res;
 	}
-	ostr << " ]";
 
+	return res;
+}
+
+Formula FormulaFactory::makeAnd(const Formula &op1, const Formula &op2)
+{
+	return makeConnective<And>(T_AND, op1, op2);
+}
+
+Formula FormulaFactory::makeOr(const Formula &op1, const Formula &op2)
+{
+	return makeConnective<Or>(T_OR, op1, op2);
+}
+
+Formula FormulaFactory::makeImp(const Formula &op1, const Formula &op2)
+{
+	return makeConnective<Imp>(T_IMP, op1, op2);
+}
+
+Formula FormulaFactory::makeIff(const Formula &op1, const Formula &op2)
+{
+	return makeConnective<Iff>(T_IFF, op1, op2);
+}
+
+//-----------------------------------------------------------------------------
+// Support functions
+//-----------------------------------------------------------------------------
+ostream& operator<<(ostream &ostr, const Formula &f)
+{
+	f->print(ostr);
+	return ostr;
+}
+
+ostream& operator<<(ostream &ostr, const Valuation &v)
+{
+	v.print(ostr);
 	return ostr;
 }
@@ -7,112 +7,208 @@
 #include <set>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <mutex>
 #include <cassert>
+#include <cstdint>
+#include "cnf.h"
+#include "symbol_table.h"
 
 class BaseFormula;
+class PostOrder;
+class ThreadPool;
 
 typedef std::shared_ptr<BaseFormula> Formula;
 typedef std::set<std::string> AtomSet;
 enum Type { T_ATOM, T_TRUE, T_FALSE, T_IFF, T_IMP, T_NOT, T_AND, T_OR };
-typedef std::vector<Formula> LiteralList;
-typedef std::vector<LiteralList> LiteralListList;
+// TM_FULL defines fresh atoms with equivalences, TM_POLARITY only with the
+// implications needed by the polarity of the subformula (Plaisted-Greenbaum)
+enum TseitinMode { TM_FULL, TM_POLARITY };
+// pending output of BaseFormula::print: a node or, if the node is null, a text
+typedef std::vector<std::pair<const BaseFormula*, const char*>> PrintStack;
 
 extern Formula parsed_formula;
 
+// a subformula with negations pushed inwards (pos) and the same for its
+// negation (neg); a form that is not needed is left null
+struct Polarized
+{
+	Formula pos, neg;
+};
 
+
+// Values of a set of atoms packed into 64-bit words and indexed by the symbols
+// of the atoms. The atoms are ordered by name and the last one is the lowest
+// bit, so next() is an increment of a multi-word number.
 class Valuation
 {
 public:
 	Valuation(const AtomSet&);
 	bool getValue(const std::string&) const;
-	void setValue(std::string&, bool);
+	void setValue(const std::string&, bool);
 	bool next();
+	void assign(uint64_t n);
 	void print(std::ostream&) const;
+
+	size_t size() const
+	{
+		return _symbols.size();
+	}
+
+	// the bit of the atom in the number of a valuation, see assign
+	unsigned getBit(unsigned symbol) const
+	{
+		assert(symbol < _bits.size() && _bits[symbol] != NONE && "atom is not in the valuation");
+
+		return _bits[symbol];
+	}
+
+	bool getValue(unsigned symbol) const
+	{
+		unsigned b = getBit(symbol);
+
+		return (_words[b >> 6] >> (b & 63)) & 1;
+	}
+
 private:
-	std::map<std::string, bool> _vars;
+	static const unsigned NONE = ~0U;
+
+	// symbols of the atoms in the order of their names
+	std::vector<unsigned> _symbols;
+	// bit of each symbol, or NONE if the atom is not in the valuation
+	std::vector<unsigned> _bits;
+	std::vector<uint64_t> _words;
 };
 
+// The passes below visit the nodes in a PostOrder and call the ...Node step of
+// each node with the results for its operands, so none of them recurses.
 class BaseFormula : public std::enable_shared_from_this<BaseFormula>
 {
 public:
+	// largest number of atoms checked by evaluating every valuation
+	static const unsigned SOLVER_ATOMS = 20;
+
+	virtual ~BaseFormula() {}
 	virtual Type getType() const = 0;
-	virtual void getAtoms(AtomSet&) const = 0;
-	virtual Formula simplify() = 0;
-	virtual Formula pushNegation() = 0;
-	virtual bool equals(const Formula&) const = 0;
-	virtual void print(std::ostream&) const = 0;
-	bool isEquivalent(const Formula&) const;
+	void getAtoms(AtomSet&) const;
+	Formula simplify();
+	Formula pushNegation();
+	bool equals(const Formula&) const;
+	void print(std::ostream&) const;
+	bool isEquivalent(const Formula&, ThreadPool *workers = nullptr) const;
 	void printTruthTable() const;
-	bool isTautology() const;
-	bool isSat(Valuation&) const;
-	virtual bool eval(const Valuation&) const = 0;
-	Formula tseitinTransformation();
-	virtual LiteralListList flatCNF() = 0;
-	virtual Formula nnf() = 0;
+	bool isTautology(ThreadPool *workers = nullptr) const;
+	bool isSat(Valuation&, ThreadPool *workers = nullptr) const;
+	bool eval(const Valuation&) const;
+	Formula tseitinTransformation(TseitinMode mode = TM_FULL);
+	void flatCNF(Cnf&) const;
+	Formula nnf();
 
 protected:
 	bool isNATF(const Formula&) const;
+	static void release(Formula&);
+
+	// operands that a node does not have are passed as null or false
+	virtual Formula simplifyNode(const Formula &op1, const Formula &op2) = 0;
+	// the pos form of the node, or the neg form if negated is set
+	virtual Formula pushNegationNode(const Polarized &op1, const Polarized &op2, bool negated) = 0;
+	virtual Formula nnfNode(const Polarized &op1, const Polarized &op2, bool negated) = 0;
+	virtual bool equalsNode(const BaseFormula*) const;
+	virtual void printNode(std::ostream&, PrintStack&) const = 0;
 
 private:
-	Formula _tseitin(const Formula&, AtomSet&, Formula&) const;
+	friend class FormulaFactory;
+	bool _interned = false;
+
+	Formula rewriteNegations(bool expandIff);
 };
 
-class AtomicFormula : public BaseFormula
+// Distinct nodes of a formula ordered so that the operands of a node come
+// before it, found with an explicit stack. The root is the last node.
+class PostOrder
 {
 public:
-	Formula simplify();
-	Formula pushNegation();
-	virtual Formula nnf();
+	PostOrder(const BaseFormula *root);
+
+	size_t size() const
+	{
+		return _nodes.size();
+	}
+
+	BaseFormula* node(size_t i) const
+	{
+		return _nodes[i];
+	}
+
+	// positions of the operands of node i, or i itself if there is no operand
+	size_t op1(size_t i) const
+	{
+		return _ops[2 * i];
+	}
+
+	size_t op2(size_t i) const
+	{
+		return _ops[2 * i + 1];
+	}
+
+private:
+	std::vector<BaseFormula*> _nodes;
+	std::vector<size_t> _ops;
+};
+
+class AtomicFormula : public BaseFormula
+{
+protected:
+	Formula simplifyNode(const Formula&, const Formula&);
+	Formula pushNegationNode(const Polarized&, const Polarized&, bool);
+	Formula nnfNode(const Polarized&, const Polarized&, bool);
 };
 
 class LogicConstant : public AtomicFormula
 {
-public:
-	void getAtoms(AtomSet&) const;
-	bool equals(const Formula&) const;
 };
 
 class True : public LogicConstant
 {
 public:
 	Type getType() const;
-	void print(std::ostream&) const;
-	bool eval(const Valuation&) const;
-	virtual LiteralListList flatCNF();
+
+protected:
+	void printNode(std::ostream&, PrintStack&) const;
 };
 
 class False : public LogicConstant
 {
 public:
 	Type getType() const;
-	void print(std::ostream&) const;
-	bool eval(const Valuation&) const;
-	virtual LiteralListList flatCNF();
+
+protected:
+	void printNode(std::ostream&, PrintStack&) const;
 };
 
 class Atom : public AtomicFormula
 {
 public:
-	Atom(const std::string &id);
+	Atom(const std::string &id, unsigned symbol);
 	Type getType() const;
-	void getAtoms(AtomSet &as) const;
-	bool equals(const Formula&) const;
-	void print(std::ostream&) const;
-	bool eval(const Valuation&) const;
 	std::string getId() const;
-	virtual LiteralListList flatCNF();
+	unsigned getSymbol() const;
+
+protected:
+	bool equalsNode(const BaseFormula*) const;
+	void printNode(std::ostream&, PrintStack&) const;
 
 private:
 	std::string _id;
+	unsigned _symbol;
 };
 
 class UnaryConnective : public BaseFormula
 {
 public:
 	UnaryConnective(const Formula &op);
+	~UnaryConnective();
 	const Formula& getOp() const;
-	void getAtoms(AtomSet &as) const;
-	bool equals(const Formula&) const;
 
 	const Formula & getOperand() const
 	{
@@ -128,23 +224,21 @@ class Not : public UnaryConnective
 public:
 	using UnaryConnective::UnaryConnective;
 	Type getType() const;
-	Formula simplify();
-	Formula pushNegation();
-	void print(std::ostream&) const;
-	bool eval(const Valuation&) const;
-	virtual LiteralListList flatCNF();
-	virtual Formula nnf();
+
+protected:
+	Formula simplifyNode(const Formula&, const Formula&);
+	Formula pushNegationNode(const Polarized&, const Polarized&, bool);
+	Formula nnfNode(const Polarized&, const Polarized&, bool);
+	void printNode(std::ostream&, PrintStack&) const;
 };
 
 class BinaryConnective : public BaseFormula
 {
 public:
 	BinaryConnective(const Formula &op1, const Formula &op2);
+	~BinaryConnective();
 	const Formula& getOp1() const;
 	const Formula& getOp2() const;
-	void getAtoms(AtomSet &as) const;
-	bool equals(const Formula&) const;
-	void print(std::ostream&) const;
 
 	const Formula & getOperand1() const
 	{
@@ -157,6 +251,9 @@ public:
 	}
 
 protected:
+	void printNode(std::ostream&, PrintStack&) const;
+	Formula remake(const Formula &op1, const Formula &op2);
+
 	Formula _op1, _op2;
 };
 
@@ -165,11 +262,11 @@ class And : public BinaryConnective
 public:
 	using BinaryConnective::BinaryConnective;
 	Type getType() const ;
-	Formula simplify();
-	Formula pushNegation();
-	bool eval(const Valuation&) const;
-	virtual LiteralListList flatCNF();
-	virtual Formula nnf();
+
+protected:
+	Formula simplifyNode(const Formula&, const Formula&);
+	Formula pushNegationNode(const Polarized&, const Polarized&, bool);
+	Formula nnfNode(const Polarized&, const Polarized&, bool);
 };
 
 class Or : public BinaryConnective
@@ -177,11 +274,11 @@ class Or : public BinaryConnective
 public:
 	using BinaryConnective::BinaryConnective;
 	Type getType() const;
-	Formula simplify();
-	Formula pushNegation();
-	bool eval(const Valuation&) const;
-	virtual LiteralListList flatCNF();
-	virtual Formula nnf();
+
+protected:
+	Formula simplifyNode(const Formula&, const Formula&);
+	Formula pushNegationNode(const Polarized&, const Polarized&, bool);
+	Formula nnfNode(const Polarized&, const Polarized&, bool);
 };
 
 class Imp : public BinaryConnective
@@ -189,11 +286,11 @@ class Imp : public BinaryConnective
 public:
 	using BinaryConnective::BinaryConnective;
 	Type getType() const;
-	Formula simplify();
-	Formula pushNegation();
-	bool eval(const Valuation&) const;
-	virtual LiteralListList flatCNF();
-	virtual Formula nnf();
+
+protected:
+	Formula simplifyNode(const Formula&, const Formula&);
+	Formula pushNegationNode(const Polarized&, const Polarized&, bool);
+	Formula nnfNode(const Polarized&, const Polarized&, bool);
 };
 
 class Iff : public BinaryConnective
@@ -201,18 +298,64 @@ class Iff : public BinaryConnective
 public:
 	using BinaryConnective::BinaryConnective;
 	Type getType() const;
-	Formula simplify();
-	Formula pushNegation();
-	bool eval(const Valuation&) const;
-	virtual LiteralListList flatCNF();
-	virtual Formula nnf();
+
+protected:
+	Formula simplifyNode(const Formula&, const Formula&);
+	Formula pushNegationNode(const Polarized&, const Polarized&, bool);
+	Formula nnfNode(const Polarized&, const Polarized&, bool);
+};
+
+// Builds hash-consed formulas: structurally equal formulas made through the
+// factory share a single node, so they can be compared by pointer.
+class FormulaFactory
+{
+public:
+	static Formula makeTrue();
+	static Formula makeFalse();
+	static Formula makeAtom(const std::string &id);
+	static Formula makeNot(const Formula &op);
+	static Formula makeAnd(const Formula &op1, const Formula &op2);
+	static Formula makeOr(const Formula &op1, const Formula &op2);
+	static Formula makeImp(const Formula &op1, const Formula &op2);
+	static Formula makeIff(const Formula &op1, const Formula &op2);
+	static unsigned getSymbol(const std::string &id);
+
+private:
+	struct Key
+	{
+		Type type;
+		const BaseFormula *op1, *op2;
+
+		bool operator==(const Key &k) const
+		{
+			return type == k.type && op1 == k.op1 && op2 == k.op2;
+		}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key &k) const;
+	};
+
+	typedef std::unordered_map<Key, std::weak_ptr<BaseFormula>, KeyHash> UniqueTable;
+	// atoms by their symbols
+	typedef std::unordered_map<unsigned, std::weak_ptr<BaseFormula>> AtomTable;
+
+	template <typename T> static Formula makeConnective(Type, const Formula&, const Formula&);
+	template <typename Table> static void purge(Table&, size_t&);
+	static Formula intern(BaseFormula*);
+
+	// the tables are shared by all threads
+	static std::mutex _mutex;
+	static UniqueTable _connectives;
+	static SymbolTable _symbols;
+	static AtomTable _atoms;
+	static size_t _connectivesLimit;
+	static size_t _atomsLimit;
 };
 
 std::ostream& operator<<(std::ostream&, const Formula&);
 std::ostream& operator<<(std::ostream&, const Valuation&);
-std::ostream& operator<<(std::ostream &, const LiteralListList &);
-
-std::string getUniqueId(const AtomSet&);
 
 
 #endif //_PROP_LOGIC_H_
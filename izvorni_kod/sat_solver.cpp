@@ -0,0 +1,552 @@
+#include "sat_solver.h"
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+const unsigned SatSolver::NONE;
+
+// 1, 1, 2, 1, 1, 2, 4, 1, 1, 2, ... the restart lengths in units of 100 conflicts
+static uint64_t luby(uint64_t i)
+{
+	uint64_t size = 1, seq = 0;
+
+	while(size < i + 1)
+	{
+		seq++;
+		size = 2 * size + 1;
+	}
+
+	while(size - 1 != i)
+	{
+		size = (size - 1) >> 1;
+		seq--;
+		i = i % size;
+	}
+
+	return 1ULL << seq;
+}
+
+SatSolver::SatSolver(const Cnf &cnf)
+	: _ok(true), _watches(2 * cnf.numVariables()), _assigns(cnf.numVariables(), V_UNDEF),
+	  _phase(cnf.numVariables(), false), _seen(cnf.numVariables(), false),
+	  _level(cnf.numVariables(), 0), _reason(cnf.numVariables(), NONE), _propagated(0),
+	  _activity(cnf.numVariables(), 0), _heapIndex(cnf.numVariables(), -1),
+	  _varInc(1), _clauseInc(1), _numLearnts(0), _conflicts(0), _decisions(0), _propagations(0)
+{
+	for(unsigned v = 0; v < cnf.numVariables(); v++)
+		heapInsert(v);
+
+	vector<Lit> lits;
+	for(size_t i = 0; i < cnf.numClauses() && _ok; i++)
+	{
+		lits.clear();
+		for(const Cnf::Literal *l = cnf.clauseBegin(i); l != cnf.clauseEnd(i); l++)
+			lits.push_back(2 * (abs(*l) - 1) + (*l < 0));
+
+		_ok = addClause(lits);
+	}
+
+	_maxLearnts = _clauses.size() / 3.0 + 1000;
+}
+
+// returns the value of the variable (numbered as in the Cnf) in the model
+// found by solve
+bool SatSolver::getValue(unsigned var) const
+{
+	return _assigns[var - 1] == V_TRUE;
+}
+
+uint64_t SatSolver::numConflicts() const
+{
+	return _conflicts;
+}
+
+uint64_t SatSolver::numDecisions() const
+{
+	return _decisions;
+}
+
+uint64_t SatSolver::numPropagations() const
+{
+	return _propagations;
+}
+
+// adds a clause of the input at level 0, returns false if the clauses
+// became unsatisfiable
+bool SatSolver::addClause(vector<Lit> &lits)
+{
+	sort(lits.begin(), lits.end());
+
+	// duplicate and false literals are dropped, a clause that has a literal
+	// and its negation or a true literal is satisfied
+	size_t j = 0;
+	for(size_t i = 0; i < lits.size(); i++)
+	{
+		if(value(lits[i]) == V_TRUE || (i > 0 && lits[i] == (lits[i - 1] ^ 1)))
+			return true;
+		if(value(lits[i]) != V_FALSE && (j == 0 || lits[i] != lits[j - 1]))
+			lits[j++] = lits[i];
+	}
+	lits.resize(j);
+
+	if(lits.empty())
+		return false;
+	if(lits.size() == 1)
+	{
+		assign(lits[0], NONE);
+		return propagate() == NONE;
+	}
+
+	storeClause(lits, false);
+	return true;
+}
+
+unsigned SatSolver::storeClause(const vector<Lit> &lits, bool learnt)
+{
+	unsigned c = _clauses.size();
+
+	_clauses.push_back(Clause{(unsigned) _lits.size(), (unsigned) lits.size(), 0, learnt, false});
+	_lits.insert(_lits.end(), lits.begin(), lits.end());
+
+	_watches[lits[0]].push_back(Watch{c, lits[1]});
+	_watches[lits[1]].push_back(Watch{c, lits[0]});
+
+	return c;
+}
+
+void SatSolver::assign(Lit l, unsigned reason)
+{
+	unsigned v = l >> 1;
+
+	_assigns[v] = !(l & 1);
+	_level[v] = decisionLevel();
+	_reason[v] = reason;
+	_trail.push_back(l);
+}
+
+// assigns the literals implied by the trail, returns a clause that became
+// false or NONE
+unsigned SatSolver::propagate()
+{
+	unsigned conflict = NONE;
+
+	while(_propagated < _trail.size())
+	{
+		Lit falseLit = _trail[_propagated++] ^ 1;
+		vector<Watch> &ws = _watches[falseLit];
+		size_t i = 0, j = 0;
+
+		_propagations++;
+
+		while(i < ws.size())
+		{
+			Watch w = ws[i++];
+
+			if(value(w.blocker) == V_TRUE)
+			{
+				ws[j++] = w;
+				continue;
+			}
+
+			Clause &c = _clauses[w.clause];
+			Lit *l = &_lits[c.begin];
+			if(l[0] == falseLit)
+				swap(l[0], l[1]);
+
+			Watch kept{w.clause, l[0]};
+			if(l[0] != w.blocker && value(l[0]) == V_TRUE)
+			{
+				ws[j++] = kept;
+				continue;
+			}
+
+			// looks for another literal to watch
+			bool moved = false;
+			for(unsigned k = 2; k < c.size; k++)
+			{
+				if(value(l[k]) != V_FALSE)
+				{
+					swap(l[1], l[k]);
+					_watches[l[1]].push_back(kept);
+					moved = true;
+					break;
+				}
+			}
+			if(moved)
+				continue;
+
+			ws[j++] = kept;
+			if(value(l[0]) == V_FALSE)
+			{
+				conflict = w.clause;
+				_propagated = _trail.size();
+				while(i < ws.size())
+					ws[j++] = ws[i++];
+			}
+			else
+				assign(l[0], w.clause);
+		}
+
+		ws.resize(j);
+	}
+
+	return conflict;
+}
+
+// Derives the first-UIP clause of the conflict, its first literal is the
+// one asserted after backtracking to backtrackLevel.
+void SatSolver::analyze(unsigned conflict, vector<Lit> &learnt, unsigned &backtrackLevel)
+{
+	int paths = 0;
+	Lit p = NONE;
+	size_t index = _trail.size();
+
+	learnt.assign(1, 0);
+
+	do
+	{
+		const Clause &c = _clauses[conflict];
+		if(c.learnt)
+			bumpClause(conflict);
+
+		// the first literal of a reason is p itself
+		for(unsigned k = p == NONE ? 0 : 1; k < c.size; k++)
+		{
+			Lit q = _lits[c.begin + k];
+			unsigned v = q >> 1;
+
+			if(_seen[v] || _level[v] == 0)
+				continue;
+
+			bumpVariable(v);
+			_seen[v] = true;
+			if(_level[v] >= decisionLevel())
+				paths++;
+			else
+				learnt.push_back(q);
+		}
+
+		while(!_seen[_trail[--index] >> 1])
+			;
+
+		p = _trail[index];
+		conflict = _reason[p >> 1];
+		_seen[p >> 1] = false;
+		paths--;
+	} while(paths > 0);
+
+	learnt[0] = p ^ 1;
+
+	// literals implied by the others are left out
+	vector<Lit> all(learnt);
+	size_t j = 1;
+	for(size_t i = 1; i < learnt.size(); i++)
+		if(!redundant(learnt[i]))
+			learnt[j++] = learnt[i];
+	learnt.resize(j);
+
+	for(Lit l : all)
+		_seen[l >> 1] = false;
+
+	// the literal of the highest level after the first is watched next
+	backtrackLevel = 0;
+	if(learnt.size() > 1)
+	{
+		size_t max = 1;
+		for(size_t i = 2; i < learnt.size(); i++)
+			if(_level[learnt[i] >> 1] > _level[learnt[max] >> 1])
+				max = i;
+
+		swap(learnt[1], learnt[max]);
+		backtrackLevel = _level[learnt[1] >> 1];
+	}
+}
+
+// true if l is implied by literals already in the learnt clause
+bool SatSolver::redundant(Lit l) const
+{
+	unsigned r = _reason[l >> 1];
+	if(r == NONE)
+		return false;
+
+	const Clause &c = _clauses[r];
+	for(unsigned k = 1; k < c.size; k++)
+	{
+		unsigned v = _lits[c.begin + k] >> 1;
+
+		if(!_seen[v] && _level[v] > 0)
+			return false;
+	}
+
+	return true;
+}
+
+void SatSolver::cancelUntil(unsigned level)
+{
+	if(decisionLevel() <= level)
+		return;
+
+	for(size_t i = _trail.size(); i-- > _trailLimits[level]; )
+	{
+		unsigned v = _trail[i] >> 1;
+
+		_phase[v] = _assigns[v];
+		_assigns[v] = V_UNDEF;
+		_reason[v] = NONE;
+		heapInsert(v);
+	}
+
+	_trail.resize(_trailLimits[level]);
+	_trailLimits.resize(level);
+	_propagated = _trail.size();
+}
+
+// the most active unassigned variable with its last value, or NONE
+SatSolver::Lit SatSolver::pickBranch()
+{
+	while(!_heap.empty())
+	{
+		unsigned v = heapPop();
+
+		if(_assigns[v] == V_UNDEF)
+			return 2 * v + !_phase[v];
+	}
+
+	return NONE;
+}
+
+SatSolver::Value SatSolver::search(uint64_t maxConflicts)
+{
+	uint64_t conflicts = 0;
+	vector<Lit> learnt;
+
+	for(;;)
+	{
+		unsigned conflict = propagate();
+
+		if(conflict != NONE)
+		{
+			_conflicts++;
+			conflicts++;
+			if(decisionLevel() == 0)
+				return V_FALSE;
+
+			unsigned level;
+			analyze(conflict, learnt, level);
+			cancelUntil(level);
+
+			if(learnt.size() == 1)
+				assign(learnt[0], NONE);
+			else
+			{
+				unsigned c = storeClause(learnt, true);
+				_numLearnts++;
+				bumpClause(c);
+				assign(learnt[0], c);
+			}
+
+			_varInc /= 0.95;
+			_clauseInc /= 0.999;
+		}
+		else
+		{
+			if(conflicts >= maxConflicts)
+			{
+				cancelUntil(0);
+				return V_UNDEF;
+			}
+
+			if(_numLearnts >= _maxLearnts + _trail.size())
+				reduceLearnts();
+
+			Lit next = pickBranch();
+			if(next == NONE)
+				return V_TRUE;
+
+			_decisions++;
+			_trailLimits.push_back(_trail.size());
+			assign(next, NONE);
+		}
+	}
+}
+
+// returns true if the clauses are satisfiable, the model is then kept
+bool SatSolver::solve()
+{
+	if(!_ok || propagate() != NONE)
+		return _ok = false;
+
+	for(uint64_t i = 0; ; i++)
+	{
+		Value res = search(100 * luby(i));
+
+		if(res != V_UNDEF)
+			return _ok = res == V_TRUE;
+
+		_maxLearnts *= 1.05;
+	}
+}
+
+// a clause that is the reason of an assignment must be kept
+bool SatSolver::locked(unsigned c) const
+{
+	Lit first = _lits[_clauses[c].begin];
+
+	return value(first) == V_TRUE && _reason[first >> 1] == c;
+}
+
+// removes the less active half of the learnt clauses
+void SatSolver::reduceLearnts()
+{
+	vector<unsigned> learnts;
+	for(unsigned c = 0; c < _clauses.size(); c++)
+		if(_clauses[c].learnt && !_clauses[c].deleted)
+			learnts.push_back(c);
+
+	sort(learnts.begin(), learnts.end(), [this](unsigned a, unsigned b)
+	{
+		return _clauses[a].activity < _clauses[b].activity;
+	});
+
+	for(size_t i = 0; i < learnts.size() / 2; i++)
+	{
+		Clause &c = _clauses[learnts[i]];
+
+		if(c.size > 2 && !locked(learnts[i]))
+		{
+			c.deleted = true;
+			_numLearnts--;
+		}
+	}
+
+	compact();
+}
+
+// Moves the clauses that are not deleted to the front of _clauses and their
+// literals to the front of _lits, keeping their order, and renumbers them
+// in the watches and reasons. Reasons of assignments are never deleted; a
+// reason left over from an unassigned variable may become NONE.
+void SatSolver::compact()
+{
+	vector<unsigned> index(_clauses.size(), NONE);
+	unsigned n = 0;
+	size_t used = 0;
+
+	for(unsigned c = 0; c < _clauses.size(); c++)
+	{
+		Clause d = _clauses[c];
+
+		if(d.deleted)
+			continue;
+
+		copy(_lits.begin() + d.begin, _lits.begin() + d.begin + d.size, _lits.begin() + used);
+		d.begin = used;
+		used += d.size;
+		index[c] = n;
+		_clauses[n++] = d;
+	}
+	_clauses.resize(n);
+	_lits.resize(used);
+
+	for(vector<Watch> &ws : _watches)
+	{
+		size_t j = 0;
+
+		for(Watch w : ws)
+			if(index[w.clause] != NONE)
+				ws[j++] = Watch{index[w.clause], w.blocker};
+		ws.resize(j);
+	}
+
+	for(unsigned &r : _reason)
+		if(r != NONE)
+			r = index[r];
+}
+
+void SatSolver::bumpVariable(unsigned v)
+{
+	if((_activity[v] += _varInc) > 1e100)
+	{
+		for(double &a : _activity)
+			a *= 1e-100;
+		_varInc *= 1e-100;
+	}
+
+	if(_heapIndex[v] >= 0)
+		heapUp(_heapIndex[v]);
+}
+
+void SatSolver::bumpClause(unsigned c)
+{
+	if((_clauses[c].activity += _clauseInc) > 1e20)
+	{
+		for(Clause &d : _clauses)
+			if(d.learnt)
+				d.activity *= 1e-20;
+		_clauseInc *= 1e-20;
+	}
+}
+
+void SatSolver::heapInsert(unsigned v)
+{
+	if(_heapIndex[v] >= 0)
+		return;
+
+	_heapIndex[v] = _heap.size();
+	_heap.push_back(v);
+	heapUp(_heap.size() - 1);
+}
+
+void SatSolver::heapUp(size_t i)
+{
+	unsigned v = _heap[i];
+
+	while(i > 0 && _activity[_heap[(i - 1) / 2]] < _activity[v])
+	{
+		_heap[i] = _heap[(i - 1) / 2];
+		_heapIndex[_heap[i]] = i;
+		i = (i - 1) / 2;
+	}
+
+	_heap[i] = v;
+	_heapIndex[v] = i;
+}
+
+void SatSolver::heapDown(size_t i)
+{
+	unsigned v = _heap[i];
+
+	for(;;)
+	{
+		size_t child = 2 * i + 1;
+		if(child >= _heap.size())
+			break;
+		if(child + 1 < _heap.size() && _activity[_heap[child + 1]] > _activity[_heap[child]])
+			child++;
+		if(_activity[_heap[child]] <= _activity[v])
+			break;
+
+		_heap[i] = _heap[child];
+		_heapIndex[_heap[i]] = i;
+		i = child;
+	}
+
+	_heap[i] = v;
+	_heapIndex[v] = i;
+}
+
+unsigned SatSolver::heapPop()
+{
+	unsigned v = _heap[0];
+
+	_heap[0] = _heap.back();
+	_heapIndex[_heap[0]] = 0;
+	_heap.pop_back();
+	_heapIndex[v] = -1;
+
+	if(!_heap.empty())
+		heapDown(0);
+
+	return v;
+}
@@ -0,0 +1,104 @@
+#ifndef _SAT_SOLVER_H_
+#define _SAT_SOLVER_H_
+
+#include "cnf.h"
+#include <cstdint>
+
+// CDCL solver for the clauses of a Cnf: two watched literals per clause,
+// VSIDS decisions with phase saving, first-UIP clause learning with clause
+// minimization, Luby restarts and removal of inactive learnt clauses.
+class SatSolver
+{
+public:
+	SatSolver(const Cnf &cnf);
+
+	bool solve();
+	bool getValue(unsigned var) const;
+
+	uint64_t numConflicts() const;
+	uint64_t numDecisions() const;
+	uint64_t numPropagations() const;
+
+private:
+	// literal of variable v (from 0) is 2 * v, its negation 2 * v + 1
+	typedef unsigned Lit;
+
+	enum Value { V_FALSE = 0, V_TRUE = 1, V_UNDEF = 2 };
+
+	// the literals of a clause are _lits[begin], ..., _lits[begin + size - 1],
+	// the first two are watched and the first is the one a reason implies;
+	// deleted is only set until reduceLearnts compacts the clauses
+	struct Clause
+	{
+		unsigned begin, size;
+		float activity;
+		bool learnt, deleted;
+	};
+
+	// the blocker is another literal of the clause, if it is true the
+	// clause need not be visited
+	struct Watch
+	{
+		unsigned clause;
+		Lit blocker;
+	};
+
+	static const unsigned NONE = ~0U;
+
+	bool _ok;
+	std::vector<Clause> _clauses;
+	std::vector<Lit> _lits;
+	// clauses watching a literal, visited when it becomes false
+	std::vector<std::vector<Watch>> _watches;
+
+	std::vector<char> _assigns, _phase, _seen;
+	std::vector<unsigned> _level, _reason;
+	std::vector<Lit> _trail;
+	std::vector<size_t> _trailLimits;
+	size_t _propagated;
+
+	// VSIDS: variables not assigned are in a binary heap by activity
+	std::vector<double> _activity;
+	std::vector<unsigned> _heap;
+	std::vector<int> _heapIndex;
+	double _varInc, _clauseInc;
+
+	size_t _numLearnts;
+	double _maxLearnts;
+	uint64_t _conflicts, _decisions, _propagations;
+
+	Value value(Lit l) const
+	{
+		char a = _assigns[l >> 1];
+
+		return a == V_UNDEF ? V_UNDEF : (Value) (a ^ (l & 1));
+	}
+
+	unsigned decisionLevel() const
+	{
+		return _trailLimits.size();
+	}
+
+	bool addClause(std::vector<Lit> &lits);
+	unsigned storeClause(const std::vector<Lit> &lits, bool learnt);
+	void assign(Lit l, unsigned reason);
+	unsigned propagate();
+	void analyze(unsigned conflict, std::vector<Lit> &learnt, unsigned &backtrackLevel);
+	bool redundant(Lit l) const;
+	void cancelUntil(unsigned level);
+	Lit pickBranch();
+	Value search(uint64_t maxConflicts);
+	void reduceLearnts();
+	void compact();
+	bool locked(unsigned c) const;
+
+	void bumpVariable(unsigned v);
+	void bumpClause(unsigned c);
+	void heapInsert(unsigned v);
+	void heapUp(size_t i);
+	void heapDown(size_t i);
+	unsigned heapPop();
+};
+
+
+#endif //_SAT_SOLVER_H_
@@ -0,0 +1,155 @@
+#include "stats.h"
+
+#ifdef STATS
+
+#include <sys/resource.h>
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+using namespace std;
+
+static const char *stageNames[NUM_STAGES] = {"input", "import", "tseitin", "nnf", "flat_cnf", "simplify", "output", "flush"};
+static const char *counterNames[NUM_COUNTERS] = {"nodes", "fresh", "clauses", "literals"};
+
+// totals of a stage
+struct StageStats
+{
+	uint64_t runs = 0;
+	double wall = 0, cpu = 0;
+	uint64_t allocations = 0, bytes = 0;
+	uint64_t counters[NUM_COUNTERS] = {};
+};
+
+static StageStats stages[NUM_STAGES];
+static mutex stagesMutex;
+
+static atomic<uint64_t> allocations(0), allocatedBytes(0);
+// the innermost timer running on each thread
+static thread_local Stats::Timer *current = nullptr;
+
+//-----------------------------------------------------------------------------
+// Allocations
+//-----------------------------------------------------------------------------
+// the other forms of new and delete of the library call these two
+void* operator new(size_t size)
+{
+	allocations.fetch_add(1, memory_order_relaxed);
+	allocatedBytes.fetch_add(size, memory_order_relaxed);
+
+	void *p = malloc(size > 0 ? size : 1);
+	if(p == nullptr)
+		throw bad_alloc();
+
+	return p;
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+//-----------------------------------------------------------------------------
+// Timer
+//-----------------------------------------------------------------------------
+Stats::Timer::Timer(Stage stage)
+	: _stage(stage), _outer(current), _total{0, 0, 0, 0}
+{
+	if(_outer != nullptr)
+		_outer->pause();
+	current = this;
+	resume();
+}
+
+Stats::Timer::~Timer()
+{
+	pause();
+	current = _outer;
+	if(_outer != nullptr)
+		_outer->resume();
+
+	lock_guard<mutex> lock(stagesMutex);
+	StageStats &s = stages[_stage];
+
+	s.wall += _total.wall;
+	s.cpu += _total.cpu;
+	s.allocations += _total.allocations;
+	s.bytes += _total.bytes;
+}
+
+Stats::Timer::Sample Stats::Timer::now()
+{
+	timespec cpu;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+
+	return Sample{
+		chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count(),
+		cpu.tv_sec + cpu.tv_nsec * 1e-9,
+		allocations.load(memory_order_relaxed),
+		allocatedBytes.load(memory_order_relaxed)
+	};
+}
+
+void Stats::Timer::pause()
+{
+	Sample end = now();
+
+	_total.wall += end.wall - _start.wall;
+	_total.cpu += end.cpu - _start.cpu;
+	_total.allocations += end.allocations - _start.allocations;
+	_total.bytes += end.bytes - _start.bytes;
+}
+
+void Stats::Timer::resume()
+{
+	_start = now();
+}
+
+//-----------------------------------------------------------------------------
+// Stats
+//-----------------------------------------------------------------------------
+void Stats::run(Stage stage)
+{
+	lock_guard<mutex> lock(stagesMutex);
+
+	stages[stage].runs++;
+}
+
+void Stats::count(Stage stage, Counter counter, uint64_t n)
+{
+	lock_guard<mutex> lock(stagesMutex);
+
+	stages[stage].counters[counter] += n;
+}
+
+// writes the totals as a JSON object, with times in milliseconds
+void Stats::write(ostream &ostr)
+{
+	lock_guard<mutex> lock(stagesMutex);
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	ostr << "{" << endl << "\t\"stages\": {" << endl;
+	for(int i = 0; i < NUM_STAGES; i++)
+	{
+		const StageStats &s = stages[i];
+
+		ostr << "\t\t\"" << stageNames[i] << "\": {"
+			<< "\"runs\": " << s.runs
+			<< ", \"wall_ms\": " << s.wall * 1000
+			<< ", \"cpu_ms\": " << s.cpu * 1000
+			<< ", \"allocations\": " << s.allocations
+			<< ", \"allocated_bytes\": " << s.bytes;
+		for(int k = 0; k < NUM_COUNTERS; k++)
+			ostr << ", \"" << counterNames[k] << "\": " << s.counters[k];
+		ostr << "}" << (i + 1 < NUM_STAGES ? "," : "") << endl;
+	}
+	ostr << "\t}," << endl
+		<< "\t\"peak_memory_kb\": " << usage.ru_maxrss << endl
+		<< "}" << endl;
+}
+
+#endif
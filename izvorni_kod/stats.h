@@ -0,0 +1,74 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <iostream>
+#include <cstdint>
+
+// stages that statistics are kept for: reading the whole input (the parse,
+// or the scan of the records of a binary file), then the stages of the
+// pipeline of each formula, from putting it into a pool to writing its
+// result, and writing out what is still buffered at the end
+enum Stage { ST_INPUT, ST_IMPORT, ST_TSEITIN, ST_NNF, ST_FLAT_CNF, ST_SIMPLIFY, ST_OUTPUT, ST_FLUSH, NUM_STAGES };
+// what is counted in each stage besides time and allocations, as sizes when
+// it ends, summed over the formulas: the nodes of the pool, the fresh atoms
+// handed out so far and the clauses and literals of the CNF
+enum Counter { SC_NODES, SC_FRESH, SC_CLAUSES, SC_LITERALS, NUM_COUNTERS };
+
+// The hooks below only do something in a build with STATS defined
+// (make STATS=1); otherwise they expand to nothing, arguments included.
+#ifdef STATS
+
+// Per-stage totals of wall time, CPU time of the process, allocations made
+// through operator new and the counters. The runs of a stage are counted
+// with run: once per formula for the stages of the pipeline, once in all
+// for ST_INPUT and ST_FLUSH. A Timer measures its stage from
+// construction to destruction. A Timer started while another one runs on the
+// same thread pauses that one, so every stage only gets its own time. CPU
+// time and allocations are those of the whole process, so stages running at
+// the same time on several threads (-b) share them.
+class Stats
+{
+public:
+	class Timer
+	{
+	public:
+		Timer(Stage stage);
+		~Timer();
+
+	private:
+		struct Sample
+		{
+			double wall, cpu;
+			uint64_t allocations, bytes;
+		};
+
+		Stage _stage;
+		Timer *_outer;
+		Sample _start, _total;
+
+		static Sample now();
+		void pause();
+		void resume();
+	};
+
+	static void run(Stage stage);
+	static void count(Stage stage, Counter counter, uint64_t n);
+	static void write(std::ostream&);
+};
+
+#define STATS_TIMER(name, stage) Stats::Timer name(stage)
+#define STATS_RUN(stage) Stats::run(stage)
+#define STATS_COUNT(stage, counter, n) Stats::count(stage, counter, n)
+#define STATS_COUNT_CNF(stage, cnf) (Stats::count(stage, SC_CLAUSES, (cnf).numClauses()), Stats::count(stage, SC_LITERALS, (cnf).numLiterals()))
+
+#else
+
+#define STATS_TIMER(name, stage)
+#define STATS_RUN(stage)
+#define STATS_COUNT(stage, counter, n)
+#define STATS_COUNT_CNF(stage, cnf)
+
+#endif
+
+
+#endif //_STATS_H_
@@ -0,0 +1,75 @@
+#include "symbol_table.h"
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+const unsigned SymbolTable::EMPTY;
+
+// FNV-1a
+static inline size_t hashName(const char *name, size_t length)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	for(size_t i = 0; i < length; i++)
+		h = (h ^ (unsigned char) name[i]) * 0x100000001b3ULL;
+
+	return (size_t) h;
+}
+
+SymbolTable::SymbolTable()
+	: _table(1024, EMPTY)
+{}
+
+// returns the id of the name, adding it if it is new
+unsigned SymbolTable::intern(const char *name, size_t length)
+{
+	size_t h = hashName(name, length);
+	size_t mask = _table.size() - 1;
+	size_t i = h & mask;
+
+	for(; _table[i] != EMPTY; i = (i + 1) & mask)
+	{
+		unsigned id = _table[i];
+
+		if(_hashes[id] == h && _names[id].size() == length && memcmp(_names[id].data(), name, length) == 0)
+			return id;
+	}
+
+	unsigned id = _names.size();
+	_names.push_back(string(name, length));
+	_hashes.push_back(h);
+	_table[i] = id;
+
+	// the table is kept at most half full
+	if(2 * _names.size() > _table.size())
+		rehash();
+
+	return id;
+}
+
+const string& SymbolTable::getName(unsigned id) const
+{
+	return _names[id];
+}
+
+size_t SymbolTable::size() const
+{
+	return _names.size();
+}
+
+void SymbolTable::rehash()
+{
+	_table.assign(2 * _table.size(), EMPTY);
+	size_t mask = _table.size() - 1;
+
+	for(unsigned id = 0; id < _names.size(); id++)
+	{
+		size_t i = _hashes[id] & mask;
+
+		while(_table[i] != EMPTY)
+			i = (i + 1) & mask;
+
+		_table[i] = id;
+	}
+}
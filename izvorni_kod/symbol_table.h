@@ -0,0 +1,32 @@
+#ifndef _SYMBOL_TABLE_H_
+#define _SYMBOL_TABLE_H_
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Interns identifiers: every distinct name gets a small integer id, numbered
+// densely from 0 in order of first appearance. Looking up a name that is
+// already known allocates nothing.
+class SymbolTable
+{
+public:
+	SymbolTable();
+
+	unsigned intern(const char *name, size_t length);
+	const std::string& getName(unsigned id) const;
+	size_t size() const;
+
+private:
+	static const unsigned EMPTY = ~0U;
+
+	std::vector<std::string> _names;
+	std::vector<size_t> _hashes;
+	// open addressing table of ids, its size is a power of two
+	std::vector<unsigned> _table;
+
+	void rehash();
+};
+
+
+#endif //_SYMBOL_TABLE_H_
@@ -0,0 +1,419 @@
+#include "prop_logic.h"
+#include "formula_pool.h"
+#include "sat_solver.h"
+#include "bdd.h"
+#include "cnf_simplifier.h"
+#include "formula_writer.h"
+#include "binary_format.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+
+using namespace std;
+
+extern int yyparse();
+extern Formula parsed_formula;
+extern void setInput(const char *begin, size_t size);
+
+// Randomized cross-checks of the parts of the pipeline against simpler
+// computations that do the same: exhaustive evaluation, a second route
+// through the code or a round trip. Every check runs on a fixed seed, so a
+// failure is reproduced by running it again. make test builds and runs
+// them; the exit status is 1 if any check failed.
+
+static mt19937 rng;
+static unsigned failures = 0;
+
+static void fail(const char *check, const string &what)
+{
+	cerr << check << ": " << what << endl;
+	failures++;
+}
+
+//-----------------------------------------------------------------------------
+// Generators
+//-----------------------------------------------------------------------------
+// random formula of at most the given depth over the atoms x0, ..., xn-1,
+// with every connective and the constants
+static Formula randomFormula(unsigned depth, unsigned atoms)
+{
+	unsigned k = rng() % (depth == 0 ? 3 : 9);
+
+	switch(k)
+	{
+		case 0: case 1:
+			return FormulaFactory::makeAtom("x" + to_string(rng() % atoms));
+		case 2:
+			if(rng() % 8 == 0)
+				return rng() % 2 ? FormulaFactory::makeTrue() : FormulaFactory::makeFalse();
+			return FormulaFactory::makeAtom("x" + to_string(rng() % atoms));
+		case 3:
+			return FormulaFactory::makeNot(randomFormula(depth - 1, atoms));
+		case 4:
+			return FormulaFactory::makeAnd(randomFormula(depth - 1, atoms), randomFormula(depth - 1, atoms));
+		case 5:
+			return FormulaFactory::makeOr(randomFormula(depth - 1, atoms), randomFormula(depth - 1, atoms));
+		case 6:
+			return FormulaFactory::makeImp(randomFormula(depth - 1, atoms), randomFormula(depth - 1, atoms));
+		default:
+			return FormulaFactory::makeIff(randomFormula(depth - 1, atoms), randomFormula(depth - 1, atoms));
+	}
+}
+
+// n + 1 pigeons in n holes, unsatisfiable and hard enough for the solver to
+// learn and remove many clauses
+static void pigeonhole(Cnf &cnf, unsigned n)
+{
+	auto var = [n](unsigned pigeon, unsigned hole) { return (Cnf::Literal) (pigeon * n + hole + 1); };
+
+	cnf.addVariables((n + 1) * n);
+	for(unsigned i = 0; i <= n; i++)
+		for(unsigned k = 0; k < n; k++)
+			cnf.setName(var(i, k), "p" + to_string(i) + "_" + to_string(k));
+
+	for(unsigned i = 0; i <= n; i++)
+	{
+		for(unsigned k = 0; k < n; k++)
+			cnf.addLiteral(var(i, k));
+		cnf.endClause();
+	}
+
+	for(unsigned k = 0; k < n; k++)
+		for(unsigned i = 0; i <= n; i++)
+			for(unsigned j = i + 1; j <= n; j++)
+			{
+				Cnf::Literal c[] = {-var(i, k), -var(j, k)};
+				cnf.addClause(c, c + 2);
+			}
+}
+
+// random 3-CNF over n variables with m clauses
+static void random3CNF(Cnf &cnf, unsigned n, unsigned m)
+{
+	cnf.addVariables(n);
+	for(unsigned v = 1; v <= n; v++)
+		cnf.setName(v, "v" + to_string(v));
+
+	for(unsigned i = 0; i < m; i++)
+	{
+		for(unsigned k = 0; k < 3; k++)
+			cnf.addLiteral((Cnf::Literal) (rng() % n + 1) * (rng() % 2 ? 1 : -1));
+		cnf.endClause();
+	}
+}
+
+static string text(const Formula &f)
+{
+	ostringstream out;
+
+	out << f;
+	return out.str();
+}
+
+//-----------------------------------------------------------------------------
+// Checks
+//-----------------------------------------------------------------------------
+// true if the solver's model satisfies every clause
+static bool satisfies(const SatSolver &solver, const Cnf &cnf)
+{
+	for(size_t i = 0; i < cnf.numClauses(); i++)
+	{
+		bool sat = false;
+
+		for(const Cnf::Literal *l = cnf.clauseBegin(i); l != cnf.clauseEnd(i) && !sat; l++)
+			sat = solver.getValue(abs(*l)) == (*l > 0);
+		if(!sat)
+			return false;
+	}
+
+	return true;
+}
+
+// The SatSolver on the Tseitin clauses of random formulas agrees with
+// exhaustive evaluation and its models satisfy the clauses. Pigeonhole
+// and random 3-CNF instances make it remove learnt clauses many times.
+static void checkSolver()
+{
+	rng.seed(16);
+
+	for(int i = 0; i < 2000; i++)
+	{
+		Formula f = randomFormula(5, 8);
+		AtomSet as;
+		f->getAtoms(as);
+		Valuation v(as);
+		bool expected = f->isSat(v);
+
+		FormulaPool pool;
+		Cnf cnf;
+		pool.tseitinCNF(pool.import(f), cnf);
+
+		SatSolver solver(cnf);
+		bool sat = solver.solve();
+		if(sat != expected)
+			fail("solver", "wrong answer for " + text(f));
+		else if(sat && !satisfies(solver, cnf))
+			fail("solver", "model does not satisfy the clauses of " + text(f));
+	}
+
+	for(unsigned n = 5; n <= 8; n++)
+	{
+		Cnf cnf;
+		pigeonhole(cnf, n);
+
+		SatSolver solver(cnf);
+		if(solver.solve())
+			fail("solver", "pigeonhole " + to_string(n) + " is satisfiable");
+	}
+
+	for(int i = 0; i < 20; i++)
+	{
+		Cnf cnf;
+		random3CNF(cnf, 150, 640);
+
+		SatSolver solver(cnf);
+		if(solver.solve() && !satisfies(solver, cnf))
+			fail("solver", "model does not satisfy random 3-CNF " + to_string(i));
+	}
+}
+
+// BDDs in every variable order agree with exhaustive evaluation on the
+// equivalence of random pairs of formulas, half of them rewritten forms of
+// each other, and on tautologies.
+static void checkBdd()
+{
+	static const BddOrder orders[] = {BO_INPUT, BO_NAME, BO_FANOUT};
+
+	rng.seed(17);
+
+	for(int i = 0; i < 1000; i++)
+	{
+		Formula f = randomFormula(5, 8);
+		FormulaPool pool;
+		NodeId a = pool.import(f);
+		NodeId b = i % 2 ? pool.nnf(a) : pool.import(randomFormula(5, 8));
+		Formula g = pool.toFormula(b);
+		bool equivalent = f->isEquivalent(g), tautology = f->isTautology();
+
+		for(BddOrder order : orders)
+		{
+			Bdd bdd(pool, order);
+			Bdd::Ref fa = bdd.build(a), fb = bdd.build(b);
+
+			if((fa == fb) != equivalent)
+				fail("bdd", "wrong equivalence of " + text(f) + " and " + text(g));
+			if((fa == Bdd::ONE) != tautology)
+				fail("bdd", "wrong tautology check of " + text(f));
+		}
+	}
+}
+
+// The simplifier keeps the satisfiability of the Tseitin clauses of random
+// formulas, with and without variable elimination, and a model of the
+// simplified clauses still satisfies the formula through its atoms, which
+// are frozen.
+static void checkSimplifier()
+{
+	rng.seed(19);
+
+	for(int i = 0; i < 2000; i++)
+	{
+		Formula f = randomFormula(5, 8);
+		AtomSet as;
+		f->getAtoms(as);
+		Valuation v(as);
+		bool expected = f->isSat(v);
+
+		FormulaPool pool;
+		Cnf cnf;
+		unsigned fresh = pool.tseitinCNF(pool.import(f), cnf);
+
+		CnfSimplifier simplifier(cnf);
+		for(unsigned var = 1; var < fresh; var++)
+			simplifier.freeze(var);
+		simplifier.run(i % 2);
+
+		SatSolver solver(cnf);
+		bool sat = solver.solve();
+		if(sat != expected)
+			fail("simplifier", "wrong answer for " + text(f));
+		else if(sat)
+		{
+			for(unsigned var = 1; var < fresh; var++)
+				v.setValue(cnf.getName(var), solver.getValue(var));
+			if(!f->eval(v))
+				fail("simplifier", "model does not satisfy " + text(f));
+		}
+	}
+}
+
+// true if the ASCII output of the writer parses back into the same node
+static bool readsBack(FormulaPool &pool, NodeId n)
+{
+	OutputBuffer out(-1);
+	FormulaWriter writer(out, true);
+
+	writer.write(pool, n);
+	writer.write(";");
+	string s = out.str();
+
+	setInput(s.data(), s.size());
+	parsed_formula = nullptr;
+	if(yyparse() != 0 || parsed_formula == nullptr)
+		return false;
+
+	return pool.import(parsed_formula) == n;
+}
+
+// Formulas written as ASCII text are read back unchanged, connectives
+// nested to the right included.
+static void checkReadBack()
+{
+	Formula a = FormulaFactory::makeAtom("a");
+	Formula b = FormulaFactory::makeAtom("b");
+	Formula c = FormulaFactory::makeAtom("c");
+	Formula nested[] =
+	{
+		FormulaFactory::makeImp(a, FormulaFactory::makeImp(b, c)),
+		FormulaFactory::makeIff(a, FormulaFactory::makeIff(b, c)),
+		FormulaFactory::makeAnd(a, FormulaFactory::makeAnd(b, c)),
+		FormulaFactory::makeOr(FormulaFactory::makeOr(a, b), FormulaFactory::makeOr(b, c))
+	};
+
+	for(const Formula &f : nested)
+	{
+		FormulaPool pool;
+		if(!readsBack(pool, pool.import(f)))
+			fail("read back", "wrong reading of " + text(f));
+	}
+
+	if(text(nested[0]) != "a => (b => c)")
+		fail("read back", "a => (b => c) printed as " + text(nested[0]));
+
+	rng.seed(24);
+
+	for(int i = 0; i < 2000; i++)
+	{
+		Formula f = randomFormula(6, 8);
+		FormulaPool pool;
+		if(!readsBack(pool, pool.import(f)))
+			fail("read back", "wrong reading of " + text(f));
+	}
+}
+
+static bool sameClauses(const Cnf &a, const Cnf &b)
+{
+	if(a.numVariables() != b.numVariables() || a.numClauses() != b.numClauses())
+		return false;
+
+	for(unsigned var = 1; var <= a.numVariables(); var++)
+		if(a.getName(var) != b.getName(var))
+			return false;
+
+	for(size_t i = 0; i < a.numClauses(); i++)
+		if(a.clauseEnd(i) - a.clauseBegin(i) != b.clauseEnd(i) - b.clauseBegin(i)
+			|| !equal(a.clauseBegin(i), a.clauseEnd(i), b.clauseBegin(i)))
+			return false;
+
+	return true;
+}
+
+// A random formula and its Tseitin clauses written as two binary records
+// are read back unchanged, data cut short is refused, and text starting
+// with an atom that spells the old magic is still parsed as text.
+static void checkBinary()
+{
+	rng.seed(25);
+
+	for(int i = 0; i < 500; i++)
+	{
+		Formula f = randomFormula(5, 8);
+		FormulaPool pool;
+		NodeId root = pool.import(f);
+		TseitinContext context("s");
+		context.reserve(i % 4);
+		Cnf cnf;
+		unsigned fresh = pool.tseitinCNF(root, cnf);
+
+		OutputBuffer out(-1);
+		BinaryWriter writer(out);
+		writer.write(pool, root, context);
+		size_t first = out.str().size();
+		writer.write(cnf, fresh, context);
+		string s = out.str();
+
+		// records are read in place, from memory aligned as a mapped file
+		vector<uint64_t> data((s.size() + 7) / 8);
+		memcpy(data.data(), s.data(), s.size());
+		const char *p = (const char*) data.data();
+
+		BinaryReader reader(p, s.size());
+		BinaryRecord record;
+		FormulaPool loaded;
+		NodeId n;
+		Cnf clauses;
+
+		if(!BinaryReader::isBinary(p, s.size()))
+			fail("binary", "no magic in the records of " + text(f));
+		if(!reader.next(record) || record.getKind() != BinaryRecord::BR_FORMULA
+			|| record.getFresh() != context.numReserved() || record.getPrefix() != "s"
+			|| !record.load(loaded, n) || !loaded.toFormula(n)->equals(f))
+			fail("binary", "wrong formula record of " + text(f));
+		if(!reader.next(record) || record.getKind() != BinaryRecord::BR_CNF || record.getFresh() != fresh
+			|| !record.load(clauses) || !sameClauses(cnf, clauses))
+			fail("binary", "wrong clause record of " + text(f));
+		if(reader.next(record) || reader.failed())
+			fail("binary", "wrong end of the records of " + text(f));
+
+		// a cut inside a record leaves it unread, one between them does not
+		size_t cut = s.size() - 8 * (rng() % (s.size() / 8) + 1);
+		BinaryReader truncated(p, cut);
+		while(truncated.next(record))
+			;
+		if(truncated.failed() != (cut != 0 && cut != first))
+			fail("binary", "records of " + text(f) + " cut at " + to_string(cut) + " read wrongly");
+	}
+
+	const char *input = "TSBFx \\/ y;";
+	Formula expected = FormulaFactory::makeOr(FormulaFactory::makeAtom("TSBFx"), FormulaFactory::makeAtom("y"));
+
+	if(BinaryReader::isBinary(input, strlen(input)))
+		fail("binary", "text taken for a binary file");
+	setInput(input, strlen(input));
+	parsed_formula = nullptr;
+	if(yyparse() != 0 || parsed_formula == nullptr || !parsed_formula->equals(expected))
+		fail("binary", "text starting with TSBF parsed wrongly");
+}
+
+//-----------------------------------------------------------------------------
+// main
+//-----------------------------------------------------------------------------
+struct Check
+{
+	const char *name;
+	void (*run)();
+};
+
+static const Check checks[] =
+{
+	{"solver", checkSolver},
+	{"bdd", checkBdd},
+	{"simplifier", checkSimplifier},
+	{"read back", checkReadBack},
+	{"binary", checkBinary}
+};
+
+int main()
+{
+	for(const Check &check : checks)
+	{
+		unsigned before = failures;
+
+		check.run();
+		cout << check.name << ": " << (failures == before ? "ok" : "FAILED") << endl;
+	}
+
+	return failures > 0 ? 1 : 0;
+}
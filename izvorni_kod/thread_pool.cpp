@@ -0,0 +1,77 @@
+#include "thread_pool.h"
+
+using namespace std;
+
+// starts the given number of workers, or one per core if it is 0
+ThreadPool::ThreadPool(unsigned threads)
+	: _stopping(false)
+{
+	if(threads == 0)
+		threads = thread::hardware_concurrency();
+	if(threads == 0)
+		threads = 1;
+
+	for(unsigned i = 0; i < threads; i++)
+		_workers.push_back(thread(&ThreadPool::work, this));
+}
+
+// runs the jobs that are still queued and joins the workers
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_ready.notify_all();
+
+	for(thread &t : _workers)
+		t.join();
+}
+
+unsigned ThreadPool::numThreads() const
+{
+	return _workers.size();
+}
+
+// runs job(0), ..., job(jobs - 1) on the workers and waits for all of them,
+// it must not be called from a job of the same pool
+void ThreadPool::run(size_t jobs, const function<void(size_t)> &job)
+{
+	vector<future<void>> done;
+
+	for(size_t k = 0; k < jobs; k++)
+		done.push_back(submit([&job, k]() { job(k); }));
+
+	for(future<void> &d : done)
+		d.get();
+}
+
+void ThreadPool::push(function<void()> job)
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_jobs.push_back(move(job));
+	}
+	_ready.notify_one();
+}
+
+void ThreadPool::work()
+{
+	for(;;)
+	{
+		function<void()> job;
+
+		{
+			unique_lock<mutex> lock(_mutex);
+			_ready.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+
+			if(_jobs.empty())
+				return;
+
+			job = move(_jobs.front());
+			_jobs.pop_front();
+		}
+
+		job();
+	}
+}
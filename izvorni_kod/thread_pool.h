@@ -0,0 +1,48 @@
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+// Fixed set of worker threads that run submitted jobs in submission order.
+// The result of a job is delivered through the future returned by submit.
+class ThreadPool
+{
+public:
+	ThreadPool(unsigned threads = 0);
+	~ThreadPool();
+
+	unsigned numThreads() const;
+	void run(size_t jobs, const std::function<void(size_t)> &job);
+
+	template <typename F> std::future<typename std::result_of<F()>::type> submit(F f)
+	{
+		typedef typename std::result_of<F()>::type Result;
+
+		// std::function needs a copyable job, so the task is shared
+		std::shared_ptr<std::packaged_task<Result()>> task = std::make_shared<std::packaged_task<Result()>>(std::move(f));
+		std::future<Result> res = task->get_future();
+
+		push([task]() { (*task)(); });
+		return res;
+	}
+
+private:
+	std::vector<std::thread> _workers;
+	std::deque<std::function<void()>> _jobs;
+	std::mutex _mutex;
+	std::condition_variable _ready;
+	bool _stopping;
+
+	void push(std::function<void()> job);
+	void work();
+};
+
+
+#endif //_THREAD_POOL_H_
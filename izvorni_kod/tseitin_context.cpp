@@ -0,0 +1,50 @@
+#include "tseitin_context.h"
+#include <cstdlib>
+
+using namespace std;
+
+TseitinContext::TseitinContext(const string &prefix)
+	: _prefix(prefix), _next(1)
+{}
+
+const string& TseitinContext::getPrefix() const
+{
+	return _prefix;
+}
+
+// returns the first of n consecutive numbers that were not handed out before
+unsigned TseitinContext::reserve(unsigned n)
+{
+	return _next.fetch_add(n, memory_order_relaxed);
+}
+
+// the number of fresh atoms handed out so far
+unsigned TseitinContext::numReserved() const
+{
+	return _next.load(memory_order_relaxed) - 1;
+}
+
+string TseitinContext::getName(unsigned number) const
+{
+	return _prefix + to_string(number);
+}
+
+// returns true and sets number if name is the name of a fresh atom
+bool TseitinContext::parseName(const string &name, unsigned &number) const
+{
+	size_t digits = name.size() - _prefix.size();
+
+	if(name.size() <= _prefix.size() || digits > 9 || name.compare(0, _prefix.size(), _prefix) != 0)
+		return false;
+	if(name[_prefix.size()] == '0' || name.find_first_not_of("0123456789", _prefix.size()) != string::npos)
+		return false;
+
+	number = strtoul(name.c_str() + _prefix.size(), nullptr, 10);
+	return true;
+}
+
+// numbers are handed out from 1 again
+void TseitinContext::reset()
+{
+	_next = 1;
+}
@@ -0,0 +1,29 @@
+#ifndef _TSEITIN_CONTEXT_H_
+#define _TSEITIN_CONTEXT_H_
+
+#include <string>
+#include <atomic>
+
+// Hands out the numbers of the fresh atoms of Tseitin transformations; the
+// atom with number k is named <prefix><k>. Numbers are taken with a single
+// atomic add, so one context can be shared by transformations running at
+// the same time and they never hand out the same name.
+class TseitinContext
+{
+public:
+	TseitinContext(const std::string &prefix = "s");
+
+	const std::string& getPrefix() const;
+	unsigned reserve(unsigned n);
+	unsigned numReserved() const;
+	std::string getName(unsigned number) const;
+	bool parseName(const std::string &name, unsigned &number) const;
+	void reset();
+
+private:
+	std::string _prefix;
+	std::atomic<unsigned> _next;
+};
+
+
+#endif //_TSEITIN_CONTEXT_H_